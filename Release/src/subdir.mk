@@ -4,21 +4,57 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../src/Batch.cpp \
+../src/Checkpoint.cpp \
+../src/Components.cpp \
+../src/DeltaKernels.cpp \
 ../src/Enumeration.cpp \
 ../src/GraphUtilities.cpp \
+../src/Library.cpp \
 ../src/MKLandscape.cpp \
+../src/MappedFile.cpp \
+../src/OptimaFile.cpp \
+../src/OptimaMerge.cpp \
+../src/OptimaSummary.cpp \
+../src/OptimaWriter.cpp \
+../src/Ordering.cpp \
+../src/StructureCache.cpp \
 ../src/main.cpp 
 
 OBJS += \
+./src/Batch.o \
+./src/Checkpoint.o \
+./src/Components.o \
+./src/DeltaKernels.o \
 ./src/Enumeration.o \
 ./src/GraphUtilities.o \
+./src/Library.o \
 ./src/MKLandscape.o \
+./src/MappedFile.o \
+./src/OptimaFile.o \
+./src/OptimaMerge.o \
+./src/OptimaSummary.o \
+./src/OptimaWriter.o \
+./src/Ordering.o \
+./src/StructureCache.o \
 ./src/main.o 
 
 CPP_DEPS += \
+./src/Batch.d \
+./src/Checkpoint.d \
+./src/Components.d \
+./src/DeltaKernels.d \
 ./src/Enumeration.d \
 ./src/GraphUtilities.d \
+./src/Library.d \
 ./src/MKLandscape.d \
+./src/MappedFile.d \
+./src/OptimaFile.d \
+./src/OptimaMerge.d \
+./src/OptimaSummary.d \
+./src/OptimaWriter.d \
+./src/Ordering.d \
+./src/StructureCache.d \
 ./src/main.d 
 
 
@@ -26,7 +62,7 @@ CPP_DEPS += \
 src/%.o: ../src/%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: Cross G++ Compiler'
-	g++ -std=c++11 -O3 -pedantic -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	g++ -std=c++11 -pthread -O3 -pedantic -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
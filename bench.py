@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+'''
+Benchmarks a build of MKL on a fixed set of MK Landscapes so that
+builds can be compared. Landscapes are created by make_mk using fixed
+seeds, every configuration is run multiple times, and the median and
+variance of each phase MKL reports are written as CSV and JSON.
+Called by "make bench" in the Release directory.
+'''
+import argparse
+import csv
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import make_mk
+
+# Phases in the order MKL reports them on its "Phase seconds:" line
+phases = ["graph", "moves", "tables", "remap", "estimate", "enumerate"]
+
+# Every (hyper, reorder) setting, and just the default one
+all_settings = [(1, 1), (1, 0), (0, 1), (0, 0)]
+default_settings = [(1, 1)]
+
+# (problem, N, k, radii, settings). Small landscapes try every setting,
+# as turning off hyperplane elimination visits all 2^N solutions.
+configurations = []
+for problem_name, k, small, large, large_radii in [
+        ("AdjacentNKq", 3, 20, 45, [1, 2]),
+        ("RandomNKq", 3, 20, 35, [1, 2]),
+        ("MAXSAT", 3, 16, 25, [1]),
+        ("IsingSpinGlass", 2, 16, 25, [1, 2]),
+        ("DeceptiveTrap", 5, 20, 60, [1, 2])]:
+    configurations.append((problem_name, small, k, [1, 2, 3], all_settings))
+    configurations.append((problem_name, large, k, large_radii, default_settings))
+
+
+def landscape_file(folder, problem_name, N, k, seed=0):
+    '''
+    Returns the filename of a landscape, creating it if it doesn't exist.
+    '''
+    filename = os.path.join(folder, "%s_%i_%i_%i.txt" % (problem_name, N, k, seed))
+    if not os.path.exists(filename):
+        make_mk.create(folder, problem_name, N, k, seed)
+    return filename
+
+
+def run(binary, filename, radius, hyper, reorder, output):
+    '''
+    Runs MKL once, returning the seconds of each phase, the total wall
+    time and how many local optima were found.
+    '''
+    command = [binary, filename, output, str(radius), str(hyper), str(reorder),
+               "--count-only"]
+    start = time.perf_counter()
+    result = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True)
+    wall = time.perf_counter() - start
+    if result.returncode != 0:
+        sys.exit("Failed: " + " ".join(command))
+    times = {}
+    for line in result.stdout.split('\n'):
+        if line.startswith("Phase seconds:"):
+            parts = line.split()[2:]
+            times = {name: float(value) for name, value in zip(parts[::2], parts[1::2])}
+    times["wall"] = wall
+    with open(output, "r") as f:
+        count = int([line for line in f if line.startswith("# Count:")][0].split()[2])
+    return times, count
+
+
+def summarize(samples):
+    '''
+    Median and variance of a list of measurements.
+    '''
+    variance = statistics.variance(samples) if len(samples) > 1 else 0.0
+    return statistics.median(samples), variance
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="MKL benchmark suite")
+    parser.add_argument('binary', help='Path to the MKL executable to benchmark')
+    parser.add_argument('-repeats', dest='repeats', type=int, default=5,
+                        help='How many times each configuration is run')
+    parser.add_argument('-folder', dest='folder', type=str, default="bench_instances",
+                        help='Where the benchmark landscapes are created')
+    parser.add_argument('-output', dest='output', type=str, default="bench_results",
+                        help='Results are written to OUTPUT.csv and OUTPUT.json')
+    parser.add_argument('-baseline', dest='baseline', type=str, default=None,
+                        help='JSON results of another build to compare against')
+    args = parser.parse_args()
+    binary = os.path.abspath(args.binary)
+    if not os.path.exists(args.folder):
+        os.makedirs(args.folder)
+
+    results = []
+    with tempfile.TemporaryDirectory() as scratch:
+        output = os.path.join(scratch, "optima.txt")
+        for problem_name, N, k, radii, settings in configurations:
+            filename = landscape_file(args.folder, problem_name, N, k)
+            for radius in radii:
+                for hyper, reorder in settings:
+                    samples = {name: [] for name in phases + ["wall"]}
+                    counts = set()
+                    for _ in range(args.repeats):
+                        times, count = run(binary, filename, radius, hyper, reorder, output)
+                        counts.add(count)
+                        for name in samples:
+                            samples[name].append(times.get(name, 0.0))
+                    if len(counts) != 1:
+                        sys.exit("Runs of %s found different counts" % filename)
+                    result = {"problem": problem_name, "N": N, "k": k,
+                              "radius": radius, "hyper": hyper, "reorder": reorder,
+                              "count": counts.pop(), "samples": samples}
+                    for name, values in samples.items():
+                        result[name + "_median"], result[name + "_variance"] = summarize(values)
+                    results.append(result)
+                    print("%s N=%i radius=%i hyper=%i reorder=%i: %.4f seconds"
+                          % (problem_name, N, radius, hyper, reorder, result["wall_median"]))
+
+    with open(args.output + ".json", "w") as f:
+        json.dump(results, f, indent=1)
+    columns = ["problem", "N", "k", "radius", "hyper", "reorder", "count"]
+    for name in phases + ["wall"]:
+        columns += [name + "_median", name + "_variance"]
+    with open(args.output + ".csv", "w") as f:
+        writer = csv.DictWriter(f, fieldnames=columns, extrasaction="ignore")
+        writer.writeheader()
+        writer.writerows(results)
+
+    if args.baseline:
+        # Report how each configuration's time changed from the baseline
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+        key = lambda r: (r["problem"], r["N"], r["k"], r["radius"], r["hyper"], r["reorder"])
+        before = {key(r): r for r in baseline}
+        for result in results:
+            old = before.get(key(result))
+            if old is None:
+                continue
+            if old["count"] != result["count"]:
+                print("COUNT CHANGED", key(result), old["count"], "->", result["count"])
+            for name in ["enumerate", "wall"]:
+                # Times of only a few milliseconds are mostly noise
+                if old[name + "_median"] > 0.01 and result[name + "_median"] > 0.01:
+                    ratio = result[name + "_median"] / old[name + "_median"]
+                    # Flag anything at least 10% slower by more than the
+                    # runs vary
+                    spread = 2 * (old[name + "_variance"] + result[name + "_variance"]) ** 0.5
+                    slower = result[name + "_median"] - old[name + "_median"] > spread
+                    flag = " SLOWER" if ratio > 1.1 and slower else ""
+                    print("%s %s: %.3fx%s" % (key(result), name, ratio, flag))
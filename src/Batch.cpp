@@ -0,0 +1,291 @@
+// Brian Goldman
+
+// Implements running the jobs of a manifest on a pool of threads
+
+#include "Batch.h"
+#include "Enumeration.h"
+#include "MKLandscape.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <vector>
+using std::vector;
+using std::cout;
+using std::endl;
+
+namespace {
+// A landscape file and what can be learned from its name
+struct LandscapeFile {
+  string filename;
+  // Name of the problem used by stats_and_graphs.R
+  string problem;
+  // Empty if the name doesn't follow make_mk.py's pattern
+  string length, k, seed;
+  // Used to schedule larger landscapes first
+  size_t size;
+  // Parsed by the first job that needs it, and freed once every job
+  // using it has finished
+  std::mutex lock;
+  std::shared_ptr<MKLandscape> landscape;
+  size_t remaining;
+};
+
+// Jobs using the same file and radius, which share an Enumeration
+struct Group {
+  size_t file;
+  size_t radius;
+  // Pairs of use_hyperplanes and use_reordering
+  vector<std::pair<bool, bool>> methods;
+};
+
+// Names used by make_mk.py, and what the paper called them
+const std::map<string, string> problem_names = {
+    {"DeceptiveTrap", "Concatenated Traps"},
+    {"AdjacentNKq", "Adjacent NKq"},
+    {"RandomNKq", "Random NKq"},
+    {"IsingSpinGlass", "Ising Spin Glass"},
+    {"MAXSAT", "MAX-kSAT"}};
+
+string method_name(bool hyper, bool reorder) {
+  if (not hyper) {
+    return reorder ? "Gray-Box-Reorder" : "Gray-Box";
+  }
+  return reorder ? "Hyper-Reorder" : "Hyper";
+}
+
+bool is_number(const string& text) {
+  return text.size() and text.find_first_not_of("0123456789") == string::npos;
+}
+
+// Fills in what can be learned from "file.filename", which make_mk.py
+// writes as "folder/Problem_N_k_seed.txt"
+void describe(LandscapeFile& file) {
+  string name = file.filename.substr(file.filename.find_last_of('/') + 1);
+  name = name.substr(0, name.find_last_of('.'));
+  vector<string> parts;
+  std::istringstream pieces(name);
+  string piece;
+  while (std::getline(pieces, piece, '_')) {
+    parts.push_back(piece);
+  }
+  file.problem = name;
+  file.size = 0;
+  if (parts.size() < 4 or not is_number(parts[parts.size() - 1])
+      or not is_number(parts[parts.size() - 2])
+      or not is_number(parts[parts.size() - 3])) {
+    return;
+  }
+  file.length = parts[parts.size() - 3];
+  file.k = parts[parts.size() - 2];
+  file.seed = parts[parts.size() - 1];
+  file.size = std::stoul(file.length);
+  file.problem = parts[0];
+  for (size_t i = 1; i + 3 < parts.size(); i++) {
+    file.problem += "_" + parts[i];
+  }
+  auto known = problem_names.find(file.problem);
+  if (known != problem_names.end()) {
+    file.problem = known->second;
+  }
+}
+
+// Only counts the local optima, stopping the enumeration once the time
+// limit has passed. Only meant for single threaded enumerations.
+class LimitSink : public OptimaSink {
+ public:
+  LimitSink(double time_limit)
+      : limited(time_limit > 0),
+        expired(false),
+        checks(0),
+        found(0) {
+    deadline = std::chrono::steady_clock::now()
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(time_limit));
+  }
+  void start(const OptimaHeader& header) override {
+  }
+  std::unique_ptr<Block> make_block() override {
+    return std::unique_ptr<Block>(new EmptyBlock());
+  }
+  void finish(size_t count, double seconds) override {
+    found = count;
+  }
+  bool stopped() const override {
+    // Called after every local optimum, so only check the clock sometimes
+    if (limited and not expired and (++checks & 15) == 0) {
+      expired = std::chrono::steady_clock::now() >= deadline;
+    }
+    return expired;
+  }
+  bool timed_out() const {
+    return expired;
+  }
+  size_t count() const {
+    return found;
+  }
+ private:
+  class EmptyBlock : public Block {
+   public:
+    void add(int, const vector<char>&, const vector<uint64_t>&,
+             int) override {
+    }
+    void submit() override {
+    }
+  };
+  bool limited;
+  mutable bool expired;
+  mutable uint32_t checks;
+  std::chrono::steady_clock::time_point deadline;
+  size_t found;
+};
+}
+
+bool run_batch(const string& manifest, const string& output, size_t threads,
+               double time_limit) {
+  std::ifstream in(manifest);
+  if (not in) {
+    cout << "Unable to read " << manifest << endl;
+    return false;
+  }
+  // Held by pointer so their mutexes never move
+  vector<std::unique_ptr<LandscapeFile>> files;
+  std::map<string, size_t> file_index;
+  std::map<std::pair<size_t, size_t>, size_t> group_index;
+  vector<Group> groups;
+  size_t jobs = 0;
+  string line;
+  for (size_t number = 1; std::getline(in, line); number++) {
+    std::istringstream fields(line);
+    string filename;
+    if (not (fields >> filename) or filename[0] == '#') {
+      continue;
+    }
+    int radius, hyper = 1, reorder = 1;
+    if (not (fields >> radius) or radius < 1) {
+      cout << manifest << " line " << number << " has no radius" << endl;
+      return false;
+    }
+    // The switches are optional, but must be numbers when given
+    for (int* value : { &hyper, &reorder }) {
+      if (not (fields >> std::ws).eof() and not (fields >> *value)) {
+        cout << manifest << " line " << number
+             << " has an invalid use_hyperplanes or use_reordering" << endl;
+        return false;
+      }
+    }
+    auto found = file_index.find(filename);
+    if (found == file_index.end()) {
+      found = file_index.emplace(filename, files.size()).first;
+      files.emplace_back(new LandscapeFile());
+      files.back()->filename = filename;
+      files.back()->remaining = 0;
+      describe(*files.back());
+    }
+    auto key = std::make_pair(found->second, size_t(radius));
+    auto group = group_index.find(key);
+    if (group == group_index.end()) {
+      group = group_index.emplace(key, groups.size()).first;
+      groups.push_back({key.first, key.second, {}});
+      files[key.first]->remaining++;
+    }
+    groups[group->second].methods.emplace_back(hyper != 0, reorder != 0);
+    jobs++;
+  }
+  std::ofstream out(output);
+  if (not out) {
+    cout << "Unable to write " << output << endl;
+    return false;
+  }
+  out << "Problem,Length,k,Method,Radius,Seed,Seconds,Count" << endl;
+
+  // Largest landscapes first, then largest radius
+  vector<size_t> order(groups.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    const auto& first = groups[a], & second = groups[b];
+    if (files[first.file]->size != files[second.file]->size) {
+      return files[first.file]->size > files[second.file]->size;
+    }
+    return first.radius > second.radius;
+  });
+  cout << "Running " << jobs << " jobs on " << files.size()
+       << " landscapes using " << threads << " threads" << endl;
+
+  std::mutex output_lock;
+  size_t finished = 0, timed_out = 0, failed = 0;
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < order.size(); i = next++) {
+      const auto& group = groups[order[i]];
+      auto& file = *files[group.file];
+      std::shared_ptr<MKLandscape> landscape;
+      {
+        std::lock_guard<std::mutex> guard(file.lock);
+        if (not file.landscape) {
+          file.landscape = std::make_shared<MKLandscape>(file.filename);
+        }
+        landscape = file.landscape;
+      }
+      if (landscape->valid()) {
+        auto setup_start = std::chrono::steady_clock::now();
+        Enumeration find_local(*landscape, group.radius);
+        find_local.set_verbose(false);
+        find_local.set_progress(0);
+        // Each job's time includes building the moves, as if it ran alone
+        double setup = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - setup_start).count();
+        for (const auto& method : group.methods) {
+          LimitSink sink(time_limit);
+          auto job_start = std::chrono::steady_clock::now();
+          find_local.enumerate(
+              sink, method.first,
+              method.second ? Ordering::moves : Ordering::none);
+          double seconds = setup + std::chrono::duration<double>(
+              std::chrono::steady_clock::now() - job_start).count();
+          std::lock_guard<std::mutex> guard(output_lock);
+          if (sink.timed_out()) {
+            timed_out++;
+            cout << "Out of time: " << file.filename << " radius "
+                 << group.radius << " " << method_name(method.first,
+                                                       method.second)
+                 << endl;
+            continue;
+          }
+          finished++;
+          // Unknown values are left for R to read as missing
+          out << file.problem << ","
+              << (file.length.size() ? file.length : "NA") << ","
+              << (file.k.size() ? file.k : "NA") << ","
+              << method_name(method.first, method.second) << ","
+              << group.radius << "," << (file.seed.size() ? file.seed : "NA")
+              << "," << seconds << "," << sink.count() << endl;
+        }
+      } else {
+        std::lock_guard<std::mutex> guard(output_lock);
+        failed += group.methods.size();
+      }
+      std::lock_guard<std::mutex> guard(file.lock);
+      if (--file.remaining == 0) {
+        file.landscape.reset();
+      }
+    }
+  };
+  vector<std::thread> pool;
+  for (size_t id = 0; id < threads; id++) {
+    pool.emplace_back(worker);
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  cout << "Finished " << finished << " jobs, " << timed_out
+       << " ran out of time and " << failed << " failed" << endl;
+  return true;
+}
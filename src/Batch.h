@@ -0,0 +1,34 @@
+// Brian Goldman
+
+// Runs many enumerations from a manifest in a single process, instead of
+// starting MKL once per configuration. Each line of the manifest is a job:
+//
+//   input_filename radius [use_hyperplanes] [use_reordering]
+//
+// using the same meaning and defaults as the command line. Blank lines
+// and lines starting with '#' are ignored. Every landscape file is only
+// parsed once, and jobs using the same file and radius share their moves.
+// Jobs are spread across a pool of threads with the largest landscapes
+// first, so the longest jobs don't start last.
+//
+// Results are written as CSV in the columns data_parsing/stats_and_graphs.R
+// reads: Problem, Length, k, Method, Radius, Seed, Seconds and Count.
+// Problem, k and Seed come from make_mk.py's "Problem_N_k_seed.txt"
+// filenames. Jobs which fail or run out of time are left out, just like
+// runs which never finished.
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <string>
+using std::string;
+#include <cstddef>
+
+// Runs every job in "manifest", writing a row to "output" as each
+// finishes. Jobs are stopped after "time_limit" seconds of enumeration,
+// or never if it is 0. Returns false if the manifest or output can't be
+// used.
+bool run_batch(const string& manifest, const string& output, size_t threads,
+               double time_limit);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,82 @@
+// Brian Goldman
+
+// Reading and writing of enumeration checkpoints.
+
+#include "Checkpoint.h"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+bool write_checkpoint(const string& filename, const Checkpoint& checkpoint) {
+  const auto& settings = checkpoint.settings;
+  string temporary = filename + ".tmp";
+  std::ofstream out(temporary, std::ios::binary);
+  out << "MKL checkpoint 2" << std::endl;
+  out << settings.length << " " << settings.radius << " " << settings.hyper
+      << " " << settings.reorder << " " << settings.tagged << std::endl;
+  for (const auto& bit : settings.new_to_org) {
+    out << bit << " ";
+  }
+  out << std::endl;
+  for (const auto bit : checkpoint.reference) {
+    out << char('0' + bit);
+  }
+  out << std::endl;
+  // Enough digits to exactly store the seconds
+  out.precision(17);
+  out << checkpoint.index << " " << checkpoint.odd << " " << settings.count
+      << " " << settings.seconds << " " << checkpoint.output_offset
+      << std::endl;
+  out << checkpoint.sink_state.size() << std::endl << checkpoint.sink_state;
+  out.close();
+  if (not out or std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Unable to write checkpoint " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool read_checkpoint(const string& filename, Checkpoint& checkpoint) {
+  auto& settings = checkpoint.settings;
+  std::ifstream in(filename, std::ios::binary);
+  string line;
+  getline(in, line);
+  if (line != "MKL checkpoint 1" and line != "MKL checkpoint 2") {
+    std::cerr << "Not a checkpoint file: " << filename << std::endl;
+    return false;
+  }
+  in >> settings.length >> settings.radius >> settings.hyper
+      >> settings.reorder;
+  settings.tagged = false;
+  if (line == "MKL checkpoint 2") {
+    in >> settings.tagged;
+  }
+  // Only complete enumerations are checkpointed
+  settings.shard = 0;
+  settings.shards = 1;
+  settings.new_to_org.resize(settings.length);
+  for (auto& bit : settings.new_to_org) {
+    in >> bit;
+  }
+  string bits;
+  in >> bits;
+  checkpoint.reference.resize(bits.size());
+  for (size_t i = 0; i < bits.size(); i++) {
+    checkpoint.reference[i] = bits[i] == '1';
+  }
+  in >> checkpoint.index >> checkpoint.odd >> settings.count
+      >> settings.seconds >> checkpoint.output_offset;
+  size_t state_size;
+  in >> state_size;
+  // Skip the newline before the sink's state
+  in.get();
+  checkpoint.sink_state.resize(state_size);
+  if (state_size) {
+    in.read(&checkpoint.sink_state[0], state_size);
+  }
+  if (not in or bits.size() != settings.length) {
+    std::cerr << "Checkpoint file is incomplete: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,43 @@
+// Brian Goldman
+
+// Stores the progress of a serial enumeration so that a run which
+// was stopped can continue exactly where it left off. Checkpoints
+// are small text files:
+// * "MKL checkpoint 2"
+// * length radius hyper reorder tagged (version 1 has no tagged)
+// * new_to_org as space-separated positions
+// * the current reference as a string of 0s and 1s
+// * index odd count seconds output_offset
+// * the size of the sink's state, a newline, then that many raw bytes
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "OptimaFile.h"
+#include <string>
+#include <vector>
+using std::vector;
+using std::string;
+
+// Everything needed to continue a serial enumeration
+struct Checkpoint {
+  // Describes the run. "count" and "seconds" are the progress so far.
+  OptimaHeader settings;
+  // The next solution which needs to be checked
+  vector<char> reference;
+  // Position of the last flip and the gray code parity
+  int index;
+  bool odd;
+  // How many bytes of the output were complete
+  uint64_t output_offset;
+  // Anything else the sink needs to continue
+  string sink_state;
+};
+
+// Writes to a temporary file first, so a crash while writing cannot
+// destroy the previous checkpoint
+bool write_checkpoint(const string& filename, const Checkpoint& checkpoint);
+// Returns false if the file does not hold a valid checkpoint
+bool read_checkpoint(const string& filename, Checkpoint& checkpoint);
+
+#endif /* CHECKPOINT_H_ */
@@ -0,0 +1,269 @@
+// Brian Goldman
+
+// Implements enumerating each connected component on its own, and
+// writing the results either per component or as every combination.
+
+#include "Components.h"
+#include "Enumeration.h"
+#include "GraphUtilities.h"
+#include "PackedBits.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+// Stores a component's local optima in memory. Components are enumerated
+// with a single thread, so its one block writes straight into the
+// component.
+class ComponentEnumeration::ComponentSink : public OptimaSink {
+ public:
+  ComponentSink(Component& component_, bool keep_)
+      : component(component_),
+        keep(keep_) {
+  }
+  void start(const OptimaHeader& header) override {
+  }
+  std::unique_ptr<Block> make_block() override {
+    return std::unique_ptr<Block>(new StoreBlock(*this));
+  }
+  void finish(size_t count, double seconds) override {
+    component.count = count;
+  }
+ private:
+  class StoreBlock : public Block {
+   public:
+    StoreBlock(ComponentSink& sink_)
+        : sink(sink_) {
+    }
+    void add(int fitness, const vector<char>& solution,
+             const vector<uint64_t>&, int radius) override {
+      if (sink.keep) {
+        auto& component = sink.component;
+        component.fitness.push_back(fitness);
+        component.radius.push_back(radius);
+        component.solutions.insert(component.solutions.end(),
+                                   solution.begin(), solution.end());
+      }
+    }
+    void submit() override {
+    }
+   private:
+    ComponentSink& sink;
+  };
+  Component& component;
+  bool keep;
+};
+
+ComponentEnumeration::ComponentEnumeration(const MKLandscape& landscape,
+                                           size_t radius_)
+    : length(landscape.get_length()),
+      radius(radius_),
+      hyper(true),
+      reorder(true),
+      all_radii(false),
+      constant(0),
+      seconds(0) {
+  auto groups = connected_components(build_graph(landscape));
+  // Where each variable is in its component
+  vector<size_t> component_of(length), local(length);
+  for (size_t c = 0; c < groups.size(); c++) {
+    for (size_t i = 0; i < groups[c].size(); i++) {
+      component_of[groups[c][i]] = c;
+      local[groups[c][i]] = i;
+    }
+  }
+  // Every variable in a subfunction is in the same component
+  vector<FlatLists<size_t>> variables(groups.size());
+  vector<FlatLists<int>> tables(groups.size());
+  vector<size_t> renamed;
+  for (const auto& subfunction : landscape.get_subfunctions()) {
+    if (subfunction.variables.size() == 0) {
+      constant += subfunction.values[0];
+      continue;
+    }
+    const size_t c = component_of[subfunction.variables[0]];
+    renamed.clear();
+    for (const auto& variable : subfunction.variables) {
+      renamed.push_back(local[variable]);
+    }
+    variables[c].add_row(renamed.begin(), renamed.end());
+    tables[c].add_row(subfunction.values.begin(), subfunction.values.end());
+  }
+  components.resize(groups.size());
+  for (size_t c = 0; c < groups.size(); c++) {
+    components[c].variables.swap(groups[c]);
+    components[c].landscape.reset(
+        new MKLandscape(components[c].variables.size(),
+                        std::move(variables[c]), std::move(tables[c])));
+    components[c].count = 0;
+  }
+}
+
+void ComponentEnumeration::set_all_radii(bool enabled) {
+  all_radii = enabled;
+}
+
+void ComponentEnumeration::enumerate(bool hyper_, Ordering ordering,
+                                     size_t threads, bool keep) {
+  hyper = hyper_;
+  reorder = ordering != Ordering::none;
+  auto start = std::chrono::steady_clock::now();
+  // Start the largest components first so they don't finish last
+  vector<size_t> order(components.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return components[a].variables.size() > components[b].variables.size();
+  });
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < order.size(); i = next++) {
+      auto& component = components[order[i]];
+      Enumeration find_local(*component.landscape, radius);
+      find_local.set_verbose(false);
+      find_local.set_progress(0);
+      find_local.set_all_radii(all_radii);
+      ComponentSink sink(component, keep);
+      find_local.enumerate(sink, hyper, ordering);
+    }
+  };
+  vector<std::thread> pool;
+  for (size_t id = 0; id < threads; id++) {
+    pool.emplace_back(worker);
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t ComponentEnumeration::count(bool& overflow) const {
+  const uint64_t most = std::numeric_limits<uint64_t>::max();
+  uint64_t total = 1;
+  overflow = false;
+  for (const auto& component : components) {
+    if (component.count == 0) {
+      return 0;
+    }
+    if (total > most / component.count) {
+      overflow = true;
+      total = most;
+    } else {
+      total *= component.count;
+    }
+  }
+  return total;
+}
+
+OptimaHeader ComponentEnumeration::header() const {
+  bool overflow;
+  OptimaHeader head = { uint32_t(length), uint32_t(radius), hyper, reorder,
+      all_radii, 0, 1, count(overflow), seconds, vector<int>(length) };
+  std::iota(head.new_to_org.begin(), head.new_to_org.end(), 0);
+  return head;
+}
+
+void ComponentEnumeration::write_factored(std::ostream& out) const {
+  const auto head = header();
+  write_text_header(out, head, nullptr);
+  out << "# Components: " << components.size() << std::endl;
+  if (constant) {
+    out << "# Constant fitness: " << constant << std::endl;
+  }
+  string line;
+  for (size_t c = 0; c < components.size(); c++) {
+    const auto& component = components[c];
+    const size_t size = component.variables.size();
+    out << "# Component " << c << " Variables:";
+    for (const auto& variable : component.variables) {
+      out << " " << variable;
+    }
+    out << std::endl << "# " << optima_columns(head) << std::endl;
+    for (size_t i = 0; i < component.fitness.size(); i++) {
+      line = std::to_string(component.fitness[i]);
+      line.push_back(' ');
+      for (size_t b = 0; b < size; b++) {
+        line.push_back('0' + component.solutions[i * size + b]);
+      }
+      if (all_radii) {
+        line.push_back(' ');
+        line += std::to_string(component.radius[i]);
+      }
+      line.push_back('\n');
+      out << line;
+    }
+    out << "# Component " << c << " Count: " << component.count
+        << std::endl;
+  }
+  bool overflow;
+  uint64_t total = count(overflow);
+  if (overflow) {
+    out << "# Count is more than " << total << std::endl;
+  }
+  write_text_footer(out, total, seconds);
+}
+
+void ComponentEnumeration::expand(OptimaSink& sink) const {
+  sink.start(header());
+  bool overflow;
+  if (count(overflow) == 0) {
+    sink.finish(0, seconds);
+    return;
+  }
+  vector<char> solution(length, 0);
+  vector<uint64_t> packed(packed_words(length), 0);
+  // Makes "solution" use optimum "i" of component "c", returning its fitness
+  auto use = [&](size_t c, size_t i) {
+    const auto& component = components[c];
+    const size_t size = component.variables.size();
+    const char* values = component.solutions.data() + i * size;
+    for (size_t b = 0; b < size; b++) {
+      const size_t variable = component.variables[b];
+      if (solution[variable] != values[b]) {
+        solution[variable] = values[b];
+        toggle_packed_bit(packed, variable);
+      }
+    }
+    return component.fitness[i];
+  };
+  int fitness = constant;
+  for (size_t c = 0; c < components.size(); c++) {
+    fitness += use(c, 0);
+  }
+  vector<size_t> choice(components.size(), 0);
+  uint64_t total = 0;
+  {
+    auto block = sink.make_block();
+    while (true) {
+      int smallest = radius;
+      if (all_radii) {
+        for (size_t c = 0; c < components.size(); c++) {
+          smallest = std::min(smallest, components[c].radius[choice[c]]);
+        }
+      }
+      block->add(fitness, solution, packed, smallest);
+      total++;
+      if (sink.stopped()) {
+        break;
+      }
+      // Count through the combinations, where the first component
+      // changes the fastest
+      size_t c = 0;
+      while (c < components.size()
+          and choice[c] + 1 == components[c].fitness.size()) {
+        fitness += use(c, 0) - components[c].fitness[choice[c]];
+        choice[c] = 0;
+        c++;
+      }
+      if (c == components.size()) {
+        break;
+      }
+      fitness += use(c, choice[c] + 1) - components[c].fitness[choice[c]];
+      choice[c]++;
+    }
+    block->submit();
+  }
+  sink.finish(total, seconds);
+}
@@ -0,0 +1,67 @@
+// Brian Goldman
+
+// Splits a landscape whose variable interaction graph is disconnected
+// into its connected components. Moves never cross between components,
+// so a solution is a local optimum exactly when its values on every
+// component are a local optimum of that component. Each component is
+// enumerated on its own, and the local optima of the whole landscape
+// are every combination of one local optimum from each component.
+
+#ifndef COMPONENTS_H_
+#define COMPONENTS_H_
+
+#include "MKLandscape.h"
+#include "OptimaSink.h"
+#include "Ordering.h"
+#include <ostream>
+#include <memory>
+
+class ComponentEnumeration {
+ public:
+  // Finds the components of "landscape", which must outlive this
+  ComponentEnumeration(const MKLandscape& landscape_, size_t radius_);
+  inline size_t size() const {
+    return components.size();
+  }
+  // Tag every 1-bit local optimum with its radius (see Enumeration.h)
+  void set_all_radii(bool enabled);
+  // Enumerates every component, giving whole components to each of
+  // "threads" threads. Each component's local optima are only stored
+  // if "keep" is set, as they are only needed to write them.
+  void enumerate(bool hyper, Ordering ordering, size_t threads, bool keep);
+  // How many local optima the whole landscape has, which is the product
+  // of the components' counts. Sets "overflow" if it doesn't fit.
+  uint64_t count(bool& overflow) const;
+  // Describes the whole enumeration. The ordering is the original one,
+  // as each component was reordered separately.
+  OptimaHeader header() const;
+  // Writes each component's variables and local optima as text, without
+  // forming any combinations. Requires "keep".
+  void write_factored(std::ostream& out) const;
+  // Gives every combination of the components' local optima to "sink",
+  // one at a time. Requires "keep".
+  void expand(OptimaSink& sink) const;
+ private:
+  // Everything found about a single component
+  struct Component {
+    // Variables of the whole landscape, in increasing order
+    vector<size_t> variables;
+    // The component's subfunctions using indices into "variables"
+    std::unique_ptr<MKLandscape> landscape;
+    size_t count;
+    // Each local optimum's fitness, radius and values of "variables",
+    // only stored if kept
+    vector<int> fitness;
+    vector<int> radius;
+    vector<char> solutions;
+  };
+  class ComponentSink;
+  size_t length, radius;
+  bool hyper, reorder, all_radii;
+  // Fitness of subfunctions without any variables, which every solution has
+  int constant;
+  vector<Component> components;
+  double seconds;
+};
+
+#endif /* COMPONENTS_H_ */
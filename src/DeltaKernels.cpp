@@ -0,0 +1,92 @@
+// Brian Goldman
+
+// Implements the vectorized delta updates. Each kernel is compiled for
+// its own instruction set using a target attribute, and only called
+// after checking the CPU supports it.
+
+#include "DeltaKernels.h"
+
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#define DELTA_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#ifdef DELTA_KERNELS_X86
+namespace {
+// Handles 8 moves at a time. Table values and deltas are gathered, but
+// AVX2 has no scatter, so the new deltas are written back one by one.
+// Bins only need updating for moves which started or stopped improving.
+__attribute__((target("avx2,popcnt")))
+size_t update_avx2(const int* values, uint32_t current, uint32_t flipped,
+                   const IndexMask* moves, size_t count, int* delta,
+                   size_t* moves_in_bin, const size_t* move_to_bin,
+                   int& improving_moves) {
+  const __m256i current_index = _mm256_set1_epi32(current);
+  const __m256i flipped_index = _mm256_set1_epi32(flipped);
+  // pre_move - just_move from the scalar loop
+  const __m256i change = _mm256_set1_epi32(values[current] - values[flipped]);
+  const __m256i zero = _mm256_setzero_si256();
+  // Moves are stored as (index, mask) pairs, so this separates them
+  const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  alignas(32) int indices[8];
+  alignas(32) int updated[8];
+  size_t done = 0;
+  for (; done + delta_batch <= count; done += delta_batch) {
+    auto pairs = reinterpret_cast<const __m256i*>(moves + done);
+    __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(pairs),
+                                              split);
+    __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(pairs + 1),
+                                               split);
+    __m256i index = _mm256_permute2x128_si256(low, high, 0x20);
+    __m256i mask = _mm256_permute2x128_si256(low, high, 0x31);
+
+    __m256i just_next = _mm256_i32gather_epi32(
+        values, _mm256_xor_si256(current_index, mask), 4);
+    __m256i move_next = _mm256_i32gather_epi32(
+        values, _mm256_xor_si256(flipped_index, mask), 4);
+    __m256i before = _mm256_i32gather_epi32(delta, index, 4);
+    __m256i after = _mm256_add_epi32(
+        before, _mm256_add_epi32(change, _mm256_sub_epi32(move_next,
+                                                          just_next)));
+
+    int was_improving = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(before, zero)));
+    int is_improving = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(after, zero)));
+    improving_moves += __builtin_popcount(is_improving)
+        - __builtin_popcount(was_improving);
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(indices), index);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(updated), after);
+    for (int i = 0; i < 8; i++) {
+      delta[indices[i]] = updated[i];
+    }
+    int changed = was_improving ^ is_improving;
+    while (changed) {
+      int i = __builtin_ctz(changed);
+      auto& bin = moves_in_bin[move_to_bin[indices[i]]];
+      if ((is_improving >> i) & 1) {
+        bin++;
+      } else {
+        bin--;
+      }
+      changed &= changed - 1;
+    }
+  }
+  return done;
+}
+}
+#endif
+
+DeltaKernel select_delta_kernel() {
+#ifdef DELTA_KERNELS_X86
+  if (__builtin_cpu_supports("avx2")) {
+    return update_avx2;
+  }
+#endif
+  return nullptr;
+}
+
+const char* delta_kernel_name() {
+  return select_delta_kernel() ? "avx2" : "scalar";
+}
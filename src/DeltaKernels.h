@@ -0,0 +1,40 @@
+// Brian Goldman
+
+// Vectorized versions of the innermost loop of a flip, which updates the
+// fitness effect of every move overlapping a flipped subfunction.
+// Which version is used is decided at run time from what the CPU
+// supports, so the program is still built for generic x86-64.
+
+#ifndef DELTAKERNELS_H_
+#define DELTAKERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Links a move or bit to a subfunction it overlaps, storing which bits
+// of the subfunction's table index are toggled when it is flipped.
+struct IndexMask {
+  uint32_t index;
+  uint32_t mask;
+};
+
+// Kernels only handle batches of this many moves
+const size_t delta_batch = 8;
+
+// Updates the first moves of "moves", which all overlap a subfunction
+// whose table index changed from "current" to "flipped". Deltas,
+// bin counts and the total number of improving moves are kept exactly
+// as the scalar loop would. Only whole batches are processed, so
+// returns how many moves were updated and the caller does the rest.
+typedef size_t (*DeltaKernel)(const int* values, uint32_t current,
+                              uint32_t flipped, const IndexMask* moves,
+                              size_t count, int* delta, size_t* moves_in_bin,
+                              const size_t* move_to_bin,
+                              int& improving_moves);
+
+// The widest kernel this CPU supports, or nullptr if there isn't one
+DeltaKernel select_delta_kernel();
+// Name of the selected kernel, such as "avx2" or "scalar"
+const char* delta_kernel_name();
+
+#endif /* DELTAKERNELS_H_ */
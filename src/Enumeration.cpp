@@ -7,51 +7,193 @@
 
 #include "Enumeration.h"
 #include <algorithm>
+#include <numeric>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <functional>
+#include <sstream>
 using std::cout;
 using std::endl;
 
-Enumeration::Enumeration(const MKLandscape & landscape_, size_t radius_)
+namespace {
+// Seconds since "since", which is then moved up to now
+double lap(std::chrono::steady_clock::time_point& since) {
+  auto now = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(now - since).count();
+  since = now;
+  return seconds;
+}
+
+// Throws away every local optimum, used when timing sample walks
+class SampleSink : public OptimaSink {
+ public:
+  void start(const OptimaHeader& header) override {
+  }
+  std::unique_ptr<Block> make_block() override {
+    return std::unique_ptr<Block>(new SampleBlock());
+  }
+  void finish(size_t count, double seconds) override {
+  }
+ private:
+  class SampleBlock : public Block {
+   public:
+    void add(int, const vector<char>&, const vector<uint64_t>&,
+             int) override {
+    }
+    void submit() override {
+    }
+  };
+};
+
+// Prints how far along an enumeration is and how quickly it is going
+void print_progress(double fraction, uint64_t visited, double seconds,
+                    size_t optima) {
+  cout << "Progress: " << 100 * fraction << "% of the search space, "
+       << visited << " solutions at " << visited / seconds
+       << " per second, " << optima << " local optima" << endl;
+}
+}
+
+void WalkStats::merge(const WalkStats& other) {
+  flips += other.flips;
+  evaluations += other.evaluations;
+  carries += other.carries;
+  if (skips.size() < other.skips.size()) {
+    skips.resize(other.skips.size(), 0);
+  }
+  for (size_t i = 0; i < other.skips.size(); i++) {
+    skips[i] += other.skips[i];
+  }
+  pass_seconds.insert(pass_seconds.end(), other.pass_seconds.begin(),
+                      other.pass_seconds.end());
+}
+
+void WalkStats::write(std::ostream& out) const {
+  out << "Flips: " << flips << endl;
+  out << "Table lookups: " << evaluations << endl;
+  out << "Carries: " << carries << endl;
+  out << "Hyperplane skips by position:";
+  for (size_t i = 0; i < skips.size(); i++) {
+    if (skips[i]) {
+      out << " " << i << ":" << skips[i];
+    }
+  }
+  out << endl;
+  if (pass_seconds.size()) {
+    out << "Pass seconds:";
+    for (const auto& seconds : pass_seconds) {
+      out << " " << seconds;
+    }
+    out << endl;
+  }
+}
+
+Enumeration::Enumeration(const MKLandscape & landscape_, size_t radius_,
+                         size_t threads, const string& structure_cache)
     : landscape(landscape_),
       length(landscape_.get_length()),
-      radius(radius_) {
+      radius(radius_),
+      tables(landscape_.get_tables()),
+      structure(structure_cache, landscape_, radius_),
+      times(),
+      checkpoint_seconds(0),
+      shard(0),
+      shards(1),
+      gather_stats(false),
+      progress_seconds(10),
+      min_fitness(std::numeric_limits<int>::min()),
+      top_k(0),
+      all_radii(false),
+      verbose(true),
+      lazy(false),
+      shared_threshold(min_fitness) {
   // Start the clock
   start = std::chrono::steady_clock::now();
-  // Find all necessary moves of radius or less bits
-  auto graph = build_graph(landscape);
-  moves = k_order_subgraphs(graph, radius);
+  auto phase_start = start;
+  // Moves only depend on the structure, so may have been saved by an
+  // earlier run along with the subfunctions they change
+  const bool cached = structure.load_moves(moves, move_to_sub);
+  if (not cached) {
+    // Find all necessary moves of radius or less bits
+    auto graph = build_graph(landscape);
+    times.graph = lap(phase_start);
+    moves = k_order_subgraphs(graph, radius, threads);
+  }
+  times.moves = lap(phase_start);
 
   // Set up a mapping between bits and the MK subfunctions they
   // are in
-  bit_to_sub.resize(length);
   const auto& subfunctions = landscape.get_subfunctions();
+  bit_to_sub = FlatLists<IndexMask>(length);
+  for (const auto& subfunction : subfunctions) {
+    for (const auto& bit : subfunction.variables) {
+      bit_to_sub.count(bit);
+    }
+  }
+  bit_to_sub.allocate();
   for (size_t sub = 0; sub < subfunctions.size(); sub++) {
-    for (const auto& bit : subfunctions[sub].variables) {
-      bit_to_sub[bit].push_back(sub);
+    const auto& variables = subfunctions[sub].variables;
+    for (size_t position = 0; position < variables.size(); position++) {
+      // The first variable is the most significant bit of the table index
+      uint32_t mask = uint32_t(1) << (variables.size() - position - 1);
+      bit_to_sub.add(variables[position], {uint32_t(sub), mask});
     }
   }
 
-  // Set up mapping from moves to the functions they affect
-  // and vice versa
-  sub_to_move.resize(subfunctions.size());
-  move_to_sub.resize(moves.size());
   single_bit_moves.resize(length, -1);
   for (size_t m = 0; m < moves.size(); m++) {
     if (moves[m].size() == 1) {
       single_bit_moves[moves[m][0]] = m;
     }
+  }
+
+  // Set up mapping from moves to the functions they affect
+  vector<IndexMask> effect;
+  for (size_t m = 0; not cached and m < moves.size(); m++) {
+    effect.clear();
     for (const auto& bit : moves[m]) {
-      for (const auto& sub : bit_to_sub[bit]) {
-        move_to_sub[m].insert(sub);
-        sub_to_move[sub].insert(m);
+      effect.insert(effect.end(), bit_to_sub[bit].begin(),
+                    bit_to_sub[bit].end());
+    }
+    // Combine the index changes of all bits in the move
+    std::sort(effect.begin(), effect.end(),
+              [](const IndexMask& a, const IndexMask& b) {
+                return a.index < b.index;
+              });
+    size_t last = 0;
+    for (size_t i = 1; i < effect.size(); i++) {
+      if (effect[last].index == effect[i].index) {
+        effect[last].mask ^= effect[i].mask;
+      } else {
+        effect[++last] = effect[i];
       }
     }
+    effect.resize(std::min(last + 1, effect.size()));
+    move_to_sub.add_row(effect.begin(), effect.end());
+  }
+  if (not cached) {
+    structure.save_moves(moves, move_to_sub);
   }
+  // and vice versa
+  link_moves();
 
-  // Table for tracking the fitness effects of making each move
-  delta.resize(moves.size(), 0);
-  fitness = 0;
-  improving_moves = 0;
-  reference.resize(length, false);
+  times.tables = lap(phase_start);
+
+  // Use code specialized to the size of the fitness tables if they are
+  // all the same
+  arity = subfunctions.size() ? subfunctions[0].variables.size() : 0;
+  for (const auto& subfunction : subfunctions) {
+    if (subfunction.variables.size() != size_t(arity)) {
+      arity = 0;
+    }
+  }
+  select_kernels();
+  delta_kernel = select_delta_kernel();
 
   // Set up reorder mapping tools, initially no change in ordering
   org_to_new.resize(length);
@@ -60,147 +202,286 @@ Enumeration::Enumeration(const MKLandscape & landscape_, size_t radius_)
   iota(new_to_org.begin(), new_to_org.end(), 0);
 }
 
-void Enumeration::initialize_deltas() {
-  fitness = 0;
+Enumeration::Enumeration(const MKLandscape & landscape_,
+                         const EnumerationOptions& options)
+    : Enumeration(landscape_, options.radius, options.threads,
+                  options.structure_cache) {
+  set_options(options);
+}
+
+void Enumeration::select_kernels() {
+  switch (arity) {
+    case 1:
+      use_kernels<1>();
+      break;
+    case 2:
+      use_kernels<2>();
+      break;
+    case 3:
+      use_kernels<3>();
+      break;
+    case 4:
+      use_kernels<4>();
+      break;
+    case 5:
+      use_kernels<5>();
+      break;
+    case 6:
+      use_kernels<6>();
+      break;
+    case 7:
+      use_kernels<7>();
+      break;
+    case 8:
+      use_kernels<8>();
+      break;
+    default:
+      arity = 0;
+      use_kernels<0>();
+  }
+}
+
+void Enumeration::set_stats(bool enabled) {
+  gather_stats = enabled;
+  select_kernels();
+}
+
+void Enumeration::set_progress(double seconds) {
+  progress_seconds = seconds;
+}
+
+void Enumeration::set_threshold(int min_fitness_, size_t top_k_) {
+  min_fitness = min_fitness_;
+  top_k = top_k_;
+  select_kernels();
+}
+
+void Enumeration::set_all_radii(bool enabled) {
+  all_radii = enabled;
+  link_moves();
+}
+
+void Enumeration::set_lazy(bool enabled) {
+  lazy = enabled;
+  link_moves();
+}
+
+bool Enumeration::lazy_larger() const {
+  return lazy and not all_radii and radius > 1;
+}
+
+void Enumeration::link_moves() {
+  const bool single_only = all_radii or lazy;
+  larger_moves.clear();
+  if (single_only) {
+    for (size_t move = 0; move < moves.size(); move++) {
+      if (moves[move].size() > 1) {
+        larger_moves.push_back(move);
+      }
+    }
+    std::stable_sort(larger_moves.begin(), larger_moves.end(),
+                     [this](size_t a, size_t b) {
+                       return moves[a].size() < moves[b].size();
+                     });
+  }
+  sub_to_move = FlatLists<IndexMask>(landscape.get_subfunctions().size());
+  for (size_t m = 0; m < moves.size(); m++) {
+    if (single_only and moves[m].size() > 1) {
+      continue;
+    }
+    for (const auto& link : move_to_sub[m]) {
+      sub_to_move.count(link.index);
+    }
+  }
+  sub_to_move.allocate();
+  for (size_t m = 0; m < moves.size(); m++) {
+    if (single_only and moves[m].size() > 1) {
+      continue;
+    }
+    for (const auto& link : move_to_sub[m]) {
+      sub_to_move.add(link.index, {uint32_t(m), link.mask});
+    }
+  }
+}
+
+void Enumeration::set_verbose(bool enabled) {
+  verbose = enabled;
+}
+
+void Enumeration::set_options(const EnumerationOptions& options) {
+  set_shard(options.shard, options.shards);
+  set_threshold(options.min_fitness, options.top_k);
+  if (options.all_radii != all_radii or options.lazy != lazy) {
+    all_radii = options.all_radii;
+    set_lazy(options.lazy);
+  }
+  set_stats(options.stats);
+  set_progress(options.progress_seconds);
+  set_verbose(options.verbose);
+}
+
+bool Enumeration::bounding() const {
+  return min_fitness > std::numeric_limits<int>::min() or top_k;
+}
+
+
+void Enumeration::initialize_deltas(SearchState& state) const {
+  state.fitness = 0;
   // fill delta with 0s
-  delta.assign(delta.size(), 0);
-  const size_t number_of_subs = landscape.get_subfunctions().size();
-  for (size_t sub = 0; sub < number_of_subs; sub++) {
-    auto score = landscape.evaluate(sub, reference);
-    fitness += score;
+  state.delta.assign(moves.size(), 0);
+  const auto& subfunctions = landscape.get_subfunctions();
+  state.packed.assign(packed_words(length), 0);
+  for (int i = 0; i < length; i++) {
+    if (state.reference[new_to_org[i]]) {
+      toggle_packed_bit(state.packed, i);
+    }
+  }
+  state.sub_index.resize(subfunctions.size());
+  for (size_t sub = 0; sub < subfunctions.size(); sub++) {
+    const auto& values = tables[sub];
+    auto current = landscape.table_index(sub, state.reference);
+    state.sub_index[sub] = current;
+    auto score = values[current];
+    state.fitness += score;
     // Update the effect each move has on this subfunction
-    for (const auto& move : sub_to_move[sub]) {
-      delta[move] -= score;
-      flip_move(move);
-      delta[move] += landscape.evaluate(sub, reference);
-      flip_move(move);
+    for (const auto& next : sub_to_move[sub]) {
+      state.delta[next.index] += values[current ^ next.mask] - score;
     }
   }
+  if (bounding()) {
+    // With nothing free the bound is just the fitness
+    state.free_bits.assign(subfunctions.size(), 0);
+    state.bound = state.fitness;
+    state.bound_level = 0;
+  }
 }
 
-// Internal function to flip all bits associated with a move
-void Enumeration::flip_move(size_t move_index) {
-  for (const auto& bit : moves[move_index]) {
-    reference[bit] = not reference[bit];
+template<int K>
+void Enumeration::use_kernels() {
+  flip_kernel = &Enumeration::flip<K, false>;
+  if (gather_stats and bounding()) {
+    walk_kernel = &Enumeration::walk<K, true, true>;
+  } else if (gather_stats) {
+    walk_kernel = &Enumeration::walk<K, true, false>;
+  } else if (bounding()) {
+    walk_kernel = &Enumeration::walk<K, false, true>;
+  } else {
+    walk_kernel = &Enumeration::walk<K, false, false>;
   }
 }
 
+template<int K>
+inline const int* Enumeration::table(size_t subfunction) const {
+  if (K) {
+    return tables.data() + (subfunction << K);
+  }
+  return tables[subfunction].begin();
+}
+
 // Given the index of a move, apply it to the solution
 // and update auxiliary information.
-int Enumeration::make_flip(size_t index) {
+int Enumeration::make_flip(SearchState& state, size_t index) const {
+  return (this->*flip_kernel)(state, index);
+}
+
+template<int K, bool Stats>
+int Enumeration::flip(SearchState& state, size_t index) const {
+  auto& delta = state.delta;
+  if (Stats) {
+    state.stats.flips++;
+  }
+  // Any larger move may have changed
+  state.version++;
   // update fitness and record it
-  fitness += delta[single_bit_moves[index]];
+  state.fitness += delta[single_bit_moves[index]];
   // For each subfunction affected by this flip
-  for (const auto& sub : bit_to_sub[index]) {
-    auto pre_move = landscape.evaluate(sub, reference);
-    reference[index] = not reference[index];  // Put in the flip
-    auto just_move = landscape.evaluate(sub, reference);
-    reference[index] = not reference[index];  // Take out move
-    // for each move that overlaps the affected subfunction
-    for (const auto& next : sub_to_move[sub]) {
-      flip_move(next);  // Put in next
-      auto just_next = landscape.evaluate(sub, reference);
-      reference[index] = not reference[index];  // Put in move
-      auto move_next = landscape.evaluate(sub, reference);
-      reference[index] = not reference[index];  // Take out move
-      flip_move(next);  // Take out next
-
-      auto & bin = moves_in_bin[move_to_bin[next]];
+  for (const auto& link : bit_to_sub[index]) {
+    const int* values = table<K>(link.index);
+    // Table indices before and after the flip
+    auto& current = state.sub_index[link.index];
+    const size_t flipped = current ^ link.mask;
+    auto pre_move = values[current];
+    auto just_move = values[flipped];
+    // for each move that overlaps the affected subfunction, updating
+    // whole batches at once if possible
+    const auto moves_here = sub_to_move[link.index];
+    if (Stats) {
+      // Two lookups for the flip and two for each overlapping move
+      state.stats.evaluations += 2 + 2 * moves_here.size();
+    }
+    const IndexMask* remaining = moves_here.begin();
+    if (delta_kernel and moves_here.size() >= delta_batch) {
+      remaining += delta_kernel(values, current, flipped, remaining,
+                                moves_here.size(), delta.data(),
+                                state.moves_in_bin.data(), move_to_bin.data(),
+                                state.improving_moves);
+    }
+    for (; remaining != moves_here.end(); remaining++) {
+      const auto& next = *remaining;
+      auto just_next = values[current ^ next.mask];
+      auto move_next = values[flipped ^ next.mask];
+
+      auto & bin = state.moves_in_bin[move_to_bin[next.index]];
       // if it was positive, remove it
-      int was_improving = (delta[next] > 0);
+      int was_improving = (delta[next.index] > 0);
       bin -= was_improving;
-      improving_moves -= was_improving;
+      state.improving_moves -= was_improving;
       // Take out old information and add in new information
-      delta[next] += (pre_move - just_next + move_next - just_move);
+      delta[next.index] += (pre_move - just_next + move_next - just_move);
       // if it is positive, add it
-      int is_improving = (delta[next] > 0);
+      int is_improving = (delta[next.index] > 0);
       bin += is_improving;
-      improving_moves += is_improving;
+      state.improving_moves += is_improving;
     }
+    current = flipped;
   }
-  reference[index] = not reference[index];  // Put in move
-  return fitness;
+  state.reference[index] = not state.reference[index];  // Put in move
+  toggle_packed_bit(state.packed, org_to_new[index]);
+  return state.fitness;
 }
 
-void Enumeration::remap() {
-  // Bin of moves based on how many dependencies it still has unsatisfied.
-  vector<unordered_set<int>> move_bin(length + 1, unordered_set<int>());
-  // Location of a move in the move_bin
-  vector<int> location(moves.size(), -1);
-  // Lookup for finding all moves with non-linear relationships to a bit
-  vector<vector<int>> bit_to_move(length, vector<int>());
-
-  for (size_t move = 0; move < moves.size(); move++) {
-    unordered_set<int> depends;
+void Enumeration::remap(Ordering ordering) {
+  if (ordering == Ordering::none) {
+    iota(new_to_org.begin(), new_to_org.end(), 0);
+  } else if (ordering == Ordering::moves) {
     // A move depends on all bits in all subfunctions it overlaps
-    for (const auto& sub : move_to_sub[move]) {
-      for (int bit : landscape.get_subfunctions()[sub].variables) {
-        depends.insert(bit);
-      }
-    }
-    // Put the move in the bin based on its dependency
-    move_bin[depends.size()].insert(move);
-    location[move] = depends.size();
-    // record all of its dependencies
-    for (const auto& bit : depends) {
-      bit_to_move[bit].push_back(move);
-    }
-  }
-
-  // Initially no position is assigned to anything
-  int highest_available = length - 1;
-  org_to_new.assign(length, -1);
-  new_to_org.assign(length, -1);
-
-  // Loop until every position is assigned
-  while (highest_available >= 0) {
-    // Find the move with the least remaining dependencies
-    // that has yet to be assigned a position
-    int move = -1;
-    for (const auto& bin : move_bin) {
-      if (bin.size()) {
-        move = *bin.begin();
-        break;
-      }
-    }
-    // If no more moves have to be assigned places, stop
-    if (move == -1) {
-      break;
-    }
-
-    // For all bits in all subfunctions related to that move,
-    // assign those bits as high as possible
-    for (const auto& sub : move_to_sub[move]) {
-      for (int bit : landscape.get_subfunctions()[sub].variables) {
-        // if the bit hasn't been assigned a new position
-        if (org_to_new[bit] == -1) {
-          org_to_new[bit] = highest_available;
-          new_to_org[highest_available] = bit;
-          // Update how many dependencies all other moves have
-          for (const auto& affected : bit_to_move[bit]) {
-            int current = location[affected];
-            // shift the affected move down 1 in the move_bin
-            move_bin[current].erase(affected);
-            move_bin[current - 1].insert(affected);
-            location[affected] = current - 1;
+    FlatLists<size_t> dependencies;
+    vector<size_t> depends;
+    vector<size_t> last_move(length, moves.size());
+    for (size_t move = 0; move < moves.size(); move++) {
+      depends.clear();
+      for (const auto& link : move_to_sub[move]) {
+        for (int bit : landscape.get_subfunctions()[link.index].variables) {
+          if (last_move[bit] != move) {
+            last_move[bit] = move;
+            depends.push_back(bit);
           }
-          highest_available--;
         }
       }
+      dependencies.add_row(depends.begin(), depends.end());
     }
-    // Remove the assigned move from the move bin
-    move_bin[0].erase(move);
+    new_to_org = order_by_moves(length, dependencies);
+  } else {
+    auto graph = build_graph(landscape);
+    if (ordering == Ordering::rcm) {
+      new_to_org = order_by_rcm(graph);
+    } else {
+      new_to_org = order_by_elimination(graph,
+                                        ordering == Ordering::min_fill);
+    }
+  }
+  for (int i = 0; i < length; i++) {
+    org_to_new[new_to_org[i]] = i;
   }
 }
 
 void Enumeration::bin_moves() {
   move_to_bin.resize(moves.size());
-  moves_in_bin.resize(length);
   for (size_t move = 0; move < moves.size(); move++) {
     // For each move, find its dependency with the minimum index
     int min_dependency = length;
-    for (const auto& sub : move_to_sub[move]) {
-      for (int bit : landscape.get_subfunctions()[sub].variables) {
+    for (const auto& link : move_to_sub[move]) {
+      for (int bit : landscape.get_subfunctions()[link.index].variables) {
         // Use the new ordering to determine "minimum"
         if (min_dependency > org_to_new[bit]) {
           min_dependency = org_to_new[bit];
@@ -209,92 +490,840 @@ void Enumeration::bin_moves() {
     }
     // Assign the move to a bin
     move_to_bin[move] = min_dependency;
+  }
+  group_larger_moves();
+}
+
+void Enumeration::group_larger_moves() {
+  larger_in_bin = FlatLists<uint32_t>(length);
+  if (lazy_larger()) {
+    // Smaller moves first, as they are cheaper to check
+    for (const auto& move : larger_moves) {
+      larger_in_bin.count(move_to_bin[move]);
+    }
+    larger_in_bin.allocate();
+    for (const auto& move : larger_moves) {
+      larger_in_bin.add(move_to_bin[move], move);
+    }
+  }
+}
+
+void Enumeration::count_improving(SearchState& state) const {
+  state.moves_in_bin.assign(length, 0);
+  state.improving_moves = 0;
+  // Nothing about the larger moves is known yet
+  state.version = 1;
+  state.bin_checked.assign(length, 0);
+  state.bin_larger.assign(length, 0);
+  for (size_t move = 0; move < moves.size(); move++) {
     // If the move is fitness improving, increment its corresponding bin
-    int is_improving = (delta[move] > 0);
-    moves_in_bin[min_dependency] += is_improving;
-    improving_moves += is_improving;
+    int is_improving = (state.delta[move] > 0);
+    state.moves_in_bin[move_to_bin[move]] += is_improving;
+    state.improving_moves += is_improving;
   }
 }
 
-void Enumeration::enumerate(std::ostream& out, bool hyper, bool reorder) {
-  // start from all 0s
-  reference.assign(length, false);
+int Enumeration::move_delta(const SearchState& state, size_t move) const {
+  int delta = 0;
+  for (const auto& link : move_to_sub[move]) {
+    const auto& values = tables[link.index];
+    const auto current = state.sub_index[link.index];
+    delta += values[current ^ link.mask] - values[current];
+  }
+  return delta;
+}
 
-  // calculate initial effects of making all possible moves
-  initialize_deltas();
-  if (reorder) {
-    // if configured to do so, change enumeration order
-    remap();
+bool Enumeration::larger_improving(SearchState& state, int bin) const {
+  // Only check again if something was flipped since the last check
+  if (state.bin_checked[bin] != state.version) {
+    state.bin_checked[bin] = state.version;
+    state.bin_larger[bin] = false;
+    for (const auto& move : larger_in_bin[bin]) {
+      if (gather_stats) {
+        state.stats.evaluations += 2 * move_to_sub[move].size();
+      }
+      if (move_delta(state, move) > 0) {
+        state.bin_larger[bin] = true;
+        break;
+      }
+    }
   }
+  return state.bin_larger[bin];
+}
+
+bool Enumeration::any_larger_improving(SearchState& state) const {
+  for (int bin = length - 1; bin >= 0; bin--) {
+    if (larger_improving(state, bin)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Enumeration::bin_open(SearchState& state, int bin) const {
+  return state.moves_in_bin[bin] == 0
+      and not (lazy_larger() and larger_improving(state, bin));
+}
+
+int Enumeration::optimum_radius(const SearchState& state) const {
+  // The smallest improving move is one bit larger than the radius
+  for (const auto& move : larger_moves) {
+    if (move_delta(state, move) > 0) {
+      return moves[move].size() - 1;
+    }
+  }
+  return radius;
+}
+
+void Enumeration::prepare_bounds() {
+  const auto& subfunctions = landscape.get_subfunctions();
+  best_tables = FlatLists<int>();
+  vector<int> row;
+  vector<size_t> order;
+  for (size_t sub = 0; sub < subfunctions.size(); sub++) {
+    const auto& variables = subfunctions[sub].variables;
+    const size_t size = tables[sub].size();
+    // Sort the variables from lowest to highest remapped position
+    order.resize(variables.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [this, &variables](size_t a, size_t b) {
+                return org_to_new[variables[a]] < org_to_new[variables[b]];
+              });
+    // Each copy frees one more variable than the last
+    row.assign(tables[sub].begin(), tables[sub].end());
+    row.resize(size * (order.size() + 1));
+    for (size_t c = 1; c <= order.size(); c++) {
+      const uint32_t mask = uint32_t(1) << (order.size() - order[c - 1] - 1);
+      int* free = row.data() + c * size;
+      const int* previous = free - size;
+      for (size_t i = 0; i < size; i++) {
+        free[i] = std::max(previous[i], previous[i ^ mask]);
+      }
+    }
+    best_tables.add_row(row.begin(), row.end());
+  }
+}
+
+void Enumeration::set_bound_level(SearchState& state, int level) const {
+  // Fix positions as the level goes down
+  while (state.bound_level > level) {
+    state.bound_level--;
+    for (const auto& link : bit_to_sub[new_to_org[state.bound_level]]) {
+      const int* best = best_tables[link.index].begin();
+      const size_t size = tables[link.index].size();
+      const size_t current = state.sub_index[link.index];
+      auto& free = state.free_bits[link.index];
+      state.bound += best[(free - 1) * size + current]
+          - best[free * size + current];
+      free--;
+    }
+  }
+  // and free them as it goes up
+  while (state.bound_level < level) {
+    for (const auto& link : bit_to_sub[new_to_org[state.bound_level]]) {
+      const int* best = best_tables[link.index].begin();
+      const size_t size = tables[link.index].size();
+      const size_t current = state.sub_index[link.index];
+      auto& free = state.free_bits[link.index];
+      state.bound += best[(free + 1) * size + current]
+          - best[free * size + current];
+      free++;
+    }
+    state.bound_level++;
+  }
+}
+
+void Enumeration::bound_flip(SearchState& state, int position) const {
+  // Free positions don't change the bound
+  if (position < state.bound_level) {
+    return;
+  }
+  for (const auto& link : bit_to_sub[new_to_org[position]]) {
+    const int* best = best_tables[link.index].begin()
+        + state.free_bits[link.index] * tables[link.index].size();
+    const size_t current = state.sub_index[link.index];
+    state.bound += best[current] - best[current ^ link.mask];
+  }
+}
+
+int Enumeration::raise_threshold(SearchState& state, int threshold) const {
+  auto& top = state.top_fitness;
+  top.push_back(state.fitness);
+  std::push_heap(top.begin(), top.end(), std::greater<int>());
+  if (top.size() > top_k) {
+    std::pop_heap(top.begin(), top.end(), std::greater<int>());
+    top.pop_back();
+  }
+  if (top.size() < top_k) {
+    return threshold;
+  }
+  // Share the k-th best with the other walks
+  int kth = top.front();
+  int shared = shared_threshold.load(std::memory_order_relaxed);
+  while (shared < kth
+      and not shared_threshold.compare_exchange_weak(shared, kth)) {
+  }
+  return std::max(threshold, kth);
+}
+
+void Enumeration::start_subspace(SearchState& state, size_t prefix,
+                                 int fixed) const {
+  state.reference.assign(length, false);
+  // The lowest bit of "prefix" sets the lowest of the fixed positions
+  for (int i = 0; i < fixed; i++) {
+    state.reference[new_to_org[length - fixed + i]] = (prefix >> i) & 1;
+  }
+  start_walk(state);
+}
+
+void Enumeration::start_walk(SearchState& state) const {
+  // calculate initial effects of making all possible moves
+  initialize_deltas(state);
   // Determine which and how many improving moves exist
-  bin_moves();
-  // tracks how many local optima are found
-  size_t count = 0;
+  count_improving(state);
+  state.index = length - 1;
+  state.odd = false;
+  state.count = 0;
+  state.visited = 0;
+}
+
+size_t Enumeration::enumerate_subspace(SearchState& state, int fixed,
+                                       bool hyper, OptimaSink& sink,
+                                       bool show_progress) const {
+  return (this->*walk_kernel)(state, fixed, hyper, sink, show_progress);
+}
 
-  // Used to output progress to the screen
+template<int K, bool Stats, bool Bound>
+size_t Enumeration::walk(SearchState& state, int fixed, bool hyper,
+                         OptimaSink& sink, bool show_progress) const {
+  const auto& packed = state.packed;
+  auto& index = state.index;
+  // Positions at or above "limit" are held constant in this subspace
+  const int limit = length - fixed;
+  // Optima are gathered here and handed to the sink in bulk
+  auto block = sink.make_block();
+
+  // Only serial walks can be checkpointed or report progress
+  const bool checkpointing = fixed == 0 and checkpoint_file.size();
+  const bool reporting = show_progress and progress_seconds > 0;
+  const auto walk_start = std::chrono::steady_clock::now();
+  auto last_checkpoint = walk_start;
+  auto last_report = walk_start;
+  // Used to time each pass
+  auto pass_start = walk_start;
   int pass = 1;
   int progress = -1;
-  cout << "Pass " << pass << ": ";
-  out << "# All " << radius << "-bit local optima" << ". Hyper is "
-      << (hyper ? "on" : "off") << ". Reorder is " << (reorder ? "on" : "off")
-      << "." << endl << "# Fitness Representation" << endl;
-  int index = length - 1;
-  // tracks parity for the gray code counter
-  bool odd = false;
+  if (Stats) {
+    state.stats.skips.resize(length, 0);
+  }
+  // Optima below this fitness are not wanted
+  int threshold = min_fitness;
+  // Only single bit moves are tracked, so larger moves must be checked
+  const bool lazy_check = lazy_larger();
+  // Set once the sink wants no more optima
+  bool stopping = sink.stopped();
+  uint64_t steps = 0;
   while (true) {
+    // Checking the clock is slow, so only do it occasionally
+    if ((++steps & 4095) == 0) {
+      if (Bound) {
+        // Other walks may have found better optima
+        threshold = std::max(
+            threshold, shared_threshold.load(std::memory_order_relaxed));
+      }
+      // Other walks may have stopped the sink
+      stopping = stopping or sink.stopped();
+    }
+    if ((steps & 4095) == 0 and (checkpointing or reporting)) {
+      auto now = std::chrono::steady_clock::now();
+      if (checkpointing
+          and std::chrono::duration<double>(now - last_checkpoint).count()
+              >= checkpoint_seconds) {
+        block->submit();
+        save_checkpoint(state, sink);
+        last_checkpoint = now;
+      }
+      if (reporting
+          and std::chrono::duration<double>(now - last_report).count()
+              >= progress_seconds) {
+        print_progress(covered(state, limit, hyper), state.visited + steps,
+                       std::chrono::duration<double>(now - walk_start).count(),
+                       state.count);
+        last_report = now;
+      }
+    }
     // If a local optima has been found, output it
-    if (improving_moves == 0) {
-      out << fitness << " ";
-      for (const auto bit : reference) {
-        out << (bit == 1);
+    if (state.improving_moves == 0
+        and (not Bound or state.fitness >= threshold)
+        and not (lazy_check and any_larger_improving(state))) {
+      block->add(state.fitness, state.reference, packed,
+                 all_radii ? optimum_radius(state) : radius);
+      state.count++;
+      if (Bound and top_k) {
+        threshold = raise_threshold(state, threshold);
       }
-      out << endl;
-      count++;
+      stopping = sink.stopped();
     }
     if (hyper) {
       // Hyperplanes let you skip areas below the highest
-      // non-zero move bin
-      while (index > 0 and moves_in_bin[index] == 0) {
+      // non-zero move bin, or whose solutions can't reach the threshold
+      while (index > 0 and state.moves_in_bin[index] == 0
+          and not (lazy_check and larger_improving(state, index))) {
+        if (Bound) {
+          set_bound_level(state, index);
+          if (state.bound < threshold) {
+            break;
+          }
+        }
         index--;
       }
+      if (Stats and index > 0) {
+        state.stats.skips[index]++;
+      }
       // Perform carry operations
-      while (index < length and reference[new_to_org[index]]) {
-        make_flip(new_to_org[index]);  // reference[index] = 0
+      while (index < limit and packed_bit(packed, index)) {
+        flip<K, Stats>(state, new_to_org[index]);  // reference[index] = 0
+        if (Bound) {
+          bound_flip(state, index);
+        }
         index++;
+        if (Stats) {
+          state.stats.carries++;
+        }
       }
     } else {
       // Perform gray code counting
       index = 0;
-      if (odd) {
+      if (state.odd) {
         // when the parity of a gray code is odd, the next flip
         // should occur after the least significant 1
-        while (index < length and reference[new_to_org[index]] == 0) {
-          index++;
-        }
+        index = first_one(packed, limit);
         // one more signficiant than the least signficiant 1
         index++;
       }
-      odd = not odd;
+      state.odd = not state.odd;
     }
     // End is reached
-    if (index >= length) {
-      cout << endl;
-      auto current = std::chrono::steady_clock::now();
-      auto elapsed = std::chrono::duration<double>(current - start).count();
-      out << "# Count: " << count << " Seconds: " << elapsed << endl;
-      return;
-    }
-    make_flip(new_to_org[index]);  // reference[index] = 1
-    // Everything below here is just for screen output purposes
-    if (index > progress) {
+    if (index >= limit or stopping) {
+      block->submit();
+      state.visited += steps;
+      if (Stats and show_progress) {
+        state.stats.pass_seconds.push_back(lap(pass_start));
+      }
+      return state.count;
+    }
+    flip<K, Stats>(state, new_to_org[index]);  // reference[index] = 1
+    if (Bound and hyper) {
+      bound_flip(state, index);
+    }
+    // A pass ends the first time the next highest position is set
+    if (Stats and show_progress and index > progress) {
       progress = index;
-      cout << index << ", ";
-      cout.flush();
       if (progress == length - pass) {
         progress = -1;
         pass++;
-        cout << endl << "Pass " << pass << ": ";
+        state.stats.pass_seconds.push_back(lap(pass_start));
       }
     }
   }
 }
+
+double Enumeration::covered(const SearchState& state, int limit,
+                            bool hyper) const {
+  // The highest 64 positions of the walk are enough for a double
+  const int width = std::min(limit, 64);
+  if (width == 0) {
+    return 1;
+  }
+  uint64_t top = packed_window(state.packed, limit - width);
+  if (width < 64) {
+    top &= (uint64_t(1) << width) - 1;
+  }
+  if (not hyper) {
+    // Gray code counting visits solutions in gray code order, so convert
+    // the gray code back into how many have been counted
+    for (int shift = 1; shift < 64; shift <<= 1) {
+      top ^= top >> shift;
+    }
+  }
+  return std::ldexp(double(top), -width);
+}
+
+double Enumeration::estimate_subspace(size_t prefix, int fixed, bool hyper,
+                                      size_t probes) const {
+  if (not hyper) {
+    // Gray code counting always visits every solution
+    return std::ldexp(1.0, length - fixed);
+  }
+  SearchState state;
+  start_subspace(state, prefix, fixed);
+  // Seeded by the prefix so every shard gets the same estimate
+  return estimate_walk(state, fixed, hyper, probes, prefix);
+}
+
+double Enumeration::estimate_walk(SearchState& state, int fixed, bool hyper,
+                                  size_t probes, uint32_t seed) const {
+  const int limit = length - fixed;
+  if (not hyper) {
+    return std::ldexp(1.0, limit);
+  }
+  // The walk skips everything below an improving move whose bits are
+  // all at or above the current position
+  for (int i = length - 1; i >= limit; i--) {
+    if (not bin_open(state, i)) {
+      return 1;
+    }
+  }
+  std::mt19937 random(seed);
+  vector<size_t> flipped;
+  double total = 0;
+  for (size_t probe = 0; probe < probes; probe++) {
+    // Knuth's estimate of tree size: follow a random path down from
+    // the subspace's root, where each level multiplies the estimated
+    // width by how many children are not skipped.
+    double width = 1;
+    double nodes = 1;
+    for (int i = limit - 1; i >= 0; i--) {
+      bool zero_open = bin_open(state, i);
+      make_flip(state, new_to_org[i]);
+      bool one_open = bin_open(state, i);
+      int open = zero_open + one_open;
+      if (open == 0) {
+        make_flip(state, new_to_org[i]);
+        break;
+      }
+      width *= open;
+      nodes += width;
+      // Keep the 1 when it is the only choice or the coin says so
+      if (one_open and (not zero_open or (random() & 1))) {
+        flipped.push_back(new_to_org[i]);
+      } else {
+        make_flip(state, new_to_org[i]);
+      }
+    }
+    total += nodes;
+    // Return to the subspace's root
+    for (const auto& bit : flipped) {
+      make_flip(state, bit);
+    }
+    flipped.clear();
+  }
+  return total / probes;
+}
+
+void Enumeration::save_checkpoint(const SearchState& state,
+                                  OptimaSink& sink) const {
+  Checkpoint checkpoint;
+  checkpoint.settings = settings;
+  checkpoint.settings.count = state.count;
+  auto current = std::chrono::steady_clock::now();
+  checkpoint.settings.seconds =
+      std::chrono::duration<double>(current - start).count();
+  checkpoint.reference = state.reference;
+  checkpoint.index = state.index;
+  checkpoint.odd = state.odd;
+  checkpoint.output_offset = sink.save(checkpoint.sink_state);
+  write_checkpoint(checkpoint_file, checkpoint);
+}
+
+void Enumeration::set_checkpoint(const string& filename, double seconds) {
+  checkpoint_file = filename;
+  checkpoint_seconds = seconds;
+}
+
+void Enumeration::set_shard(size_t shard_, size_t shards_) {
+  shard = shard_;
+  shards = shards_;
+}
+
+int Enumeration::split_bits(size_t parts) const {
+  int fixed = 0;
+  while ((size_t(1) << fixed) < parts and fixed < length and fixed < 30) {
+    fixed++;
+  }
+  return fixed;
+}
+
+namespace {
+// One worker's share of the subspaces. The owner takes work from the
+// front, while idle workers steal from the back.
+struct WorkQueue {
+  std::mutex lock;
+  std::deque<size_t> prefixes;
+};
+}
+
+size_t Enumeration::parallel_enumerate(OptimaSink& sink, bool hyper,
+                                       int fixed,
+                                       const vector<size_t>& prefixes,
+                                       size_t threads) {
+  const size_t subspaces = prefixes.size();
+  // Deal out contiguous blocks of subspaces to each worker
+  vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < subspaces; i++) {
+    queues[i * threads / subspaces].prefixes.push_back(prefixes[i]);
+  }
+
+  std::mutex progress_lock;
+  std::atomic<size_t> count(0);
+  size_t finished = 0;
+  uint64_t visited = 0;
+  const auto walk_start = std::chrono::steady_clock::now();
+  auto last_report = walk_start;
+  if (verbose) {
+    cout << "Enumerating " << subspaces << " subspaces using " << threads
+         << " threads" << endl;
+  }
+  auto worker = [&](size_t id) {
+    SearchState state;
+    while (true) {
+      // Look in this worker's queue first, then try to steal
+      size_t prefix = 0;
+      bool found = false;
+      for (size_t offset = 0; offset < threads and not found; offset++) {
+        auto& queue = queues[(id + offset) % threads];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.prefixes.size()) {
+          if (offset == 0) {
+            prefix = queue.prefixes.front();
+            queue.prefixes.pop_front();
+          } else {
+            prefix = queue.prefixes.back();
+            queue.prefixes.pop_back();
+          }
+          found = true;
+        }
+      }
+      // No work is added after starting, so all queues are done
+      if (not found or sink.stopped()) {
+        std::lock_guard<std::mutex> guard(progress_lock);
+        stats.merge(state.stats);
+        return;
+      }
+      start_subspace(state, prefix, fixed);
+      count += enumerate_subspace(state, fixed, hyper, sink, false);
+      std::lock_guard<std::mutex> guard(progress_lock);
+      finished++;
+      visited += state.visited;
+      auto now = std::chrono::steady_clock::now();
+      if (progress_seconds > 0
+          and std::chrono::duration<double>(now - last_report).count()
+              >= progress_seconds) {
+        print_progress(double(finished) / subspaces, visited,
+                       std::chrono::duration<double>(now - walk_start).count(),
+                       count);
+        last_report = now;
+      }
+    }
+  };
+  vector<std::thread> pool;
+  for (size_t id = 0; id < threads; id++) {
+    pool.emplace_back(worker, id);
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  return count;
+}
+
+size_t Enumeration::shard_enumerate(OptimaSink& sink, bool hyper,
+                                    size_t threads) {
+  // Like threads, shards need many subspaces each to balance well
+  const int fixed = split_bits(shards * 16);
+  const size_t subspaces = size_t(1) << fixed;
+  cout << "Estimating the cost of " << subspaces << " subspaces" << endl;
+  vector<double> cost(subspaces);
+  for (size_t prefix = 0; prefix < subspaces; prefix++) {
+    cost[prefix] = estimate_subspace(prefix, fixed, hyper, 64);
+  }
+  // Give the most expensive remaining subspace to the shard with the
+  // least estimated work. Ties always go the same way, so every shard
+  // finds the same split without communicating.
+  vector<size_t> order(subspaces);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&cost](size_t a, size_t b) {
+    return cost[a] > cost[b];
+  });
+  vector<double> load(shards, 0);
+  vector<size_t> prefixes;
+  for (const auto& prefix : order) {
+    size_t lightest = 0;
+    for (size_t i = 1; i < shards; i++) {
+      if (load[i] < load[lightest]) {
+        lightest = i;
+      }
+    }
+    load[lightest] += cost[prefix];
+    if (lightest == shard) {
+      prefixes.push_back(prefix);
+    }
+  }
+  // Walk in counting order to keep the output in a predictable order
+  std::sort(prefixes.begin(), prefixes.end());
+  double total = std::accumulate(load.begin(), load.end(), 0.0);
+  cout << "Shard " << shard << " of " << shards << " has " << prefixes.size()
+       << " subspaces and " << 100 * load[shard] / total
+       << "% of the estimated work" << endl;
+  return parallel_enumerate(sink, hyper, fixed, prefixes, threads);
+}
+
+uint64_t Enumeration::flip_lookups(
+    const FlatLists<size_t>& sub_variables) const {
+  // Moves which flip each variable
+  FlatLists<uint32_t> bit_to_move(length);
+  const bool single_only = all_radii or lazy;
+  for (size_t m = 0; m < moves.size(); m++) {
+    if (single_only and moves[m].size() > 1) {
+      continue;
+    }
+    for (const auto& bit : moves[m]) {
+      bit_to_move.count(bit);
+    }
+  }
+  bit_to_move.allocate();
+  for (size_t m = 0; m < moves.size(); m++) {
+    if (single_only and moves[m].size() > 1) {
+      continue;
+    }
+    for (const auto& bit : moves[m]) {
+      bit_to_move.add(bit, m);
+    }
+  }
+  // Matches the lookups counted by WalkStats: flipping a bit makes two
+  // lookups in each of its subfunctions and two for each move overlapping
+  // that subfunction
+  uint64_t lookups = 0;
+  vector<size_t> last(moves.size(), sub_variables.size());
+  for (size_t sub = 0; sub < sub_variables.size(); sub++) {
+    uint64_t overlapping = 0;
+    for (const auto& bit : sub_variables[sub]) {
+      for (const auto& m : bit_to_move[bit]) {
+        if (last[m] != sub) {
+          last[m] = sub;
+          overlapping++;
+        }
+      }
+    }
+    lookups += sub_variables[sub].size() * (2 + 2 * overlapping);
+  }
+  return lookups;
+}
+
+void Enumeration::use_ordering(Ordering ordering) {
+  if (structure.load_order(ordering, moves.size(), new_to_org, move_to_bin)) {
+    for (int i = 0; i < length; i++) {
+      org_to_new[new_to_org[i]] = i;
+    }
+    group_larger_moves();
+  } else {
+    remap(ordering);
+    bin_moves();
+    structure.save_order(ordering, new_to_org, move_to_bin);
+  }
+}
+
+double Enumeration::predict_cost(Ordering ordering, bool hyper) {
+  auto phase_start = std::chrono::steady_clock::now();
+  use_ordering(ordering);
+  times.remap = lap(phase_start);
+  double cost = estimate_subspace(0, 0, hyper, 256);
+  times.estimate = lap(phase_start);
+  return cost;
+}
+
+void Enumeration::enumerate(OptimaSink& sink, bool hyper, Ordering ordering,
+                            size_t threads) {
+  // Change enumeration order and determine which bin each move belongs to.
+  // The cost is only predicted when it is going to be printed.
+  if (verbose) {
+    double cost = predict_cost(ordering, hyper);
+    cout << "Ordering " << ordering_name(ordering)
+         << " has a predicted cost of " << cost << endl;
+  } else {
+    auto phase_start = std::chrono::steady_clock::now();
+    use_ordering(ordering);
+    times.remap = lap(phase_start);
+    times.estimate = 0;
+  }
+  run(sink, hyper, ordering, threads, "");
+}
+
+Strategy Enumeration::choose_strategy() {
+  // Hyperplanes with every ordering, then gray code counting, where
+  // the ordering makes no difference
+  vector<Strategy> candidates;
+  for (const auto& ordering : all_orderings()) {
+    candidates.push_back({ true, ordering, 0, 0 });
+  }
+  candidates.push_back({ false, Ordering::none, 0, 0 });
+  // Sample walks cover the lowest "sample_bits" positions, starting from
+  // random values for the rest
+  const int sample_bits = 12;
+  const int fixed = std::min(length, std::max(1, length - sample_bits));
+  const double budget = 0.05;
+  double remap_seconds = 0, estimate_seconds = 0;
+  SampleSink sink;
+  Strategy best = { true, Ordering::moves, 0,
+      std::numeric_limits<double>::infinity() };
+  for (auto& candidate : candidates) {
+    candidate.cost = predict_cost(candidate.ordering, candidate.hyper);
+    remap_seconds += times.remap;
+    estimate_seconds += times.estimate;
+    auto sample_start = std::chrono::steady_clock::now();
+    if (bounding()) {
+      prepare_bounds();
+      shared_threshold = min_fitness;
+    }
+    // Every candidate starts from the same random values
+    std::mt19937 random(0);
+    SearchState state;
+    double predicted = 0, seconds = 0;
+    for (size_t sample = 0; sample < 32; sample++) {
+      if (sample >= 4
+          and std::chrono::duration<double>(
+              std::chrono::steady_clock::now() - sample_start).count()
+              >= budget) {
+        break;
+      }
+      state.reference.assign(length, false);
+      for (int i = length - fixed; i < length; i++) {
+        state.reference[new_to_org[i]] = random() & 1;
+      }
+      start_walk(state);
+      predicted += estimate_walk(state, fixed, candidate.hyper, 16, random());
+      auto walk_start = std::chrono::steady_clock::now();
+      enumerate_subspace(state, fixed, candidate.hyper, sink, false);
+      seconds += lap(walk_start);
+    }
+    // Seconds per unit of predicted cost, as measured by the samples
+    candidate.seconds = candidate.cost * seconds / predicted;
+    estimate_seconds += lap(sample_start);
+    if (verbose) {
+      cout << "Hyper " << (candidate.hyper ? "on" : "off") << " with ordering "
+           << ordering_name(candidate.ordering) << " has a predicted cost of "
+           << candidate.cost << " taking " << candidate.seconds << " seconds"
+           << endl;
+    }
+    if (candidate.seconds < best.seconds) {
+      best = candidate;
+    }
+  }
+  times.remap = remap_seconds;
+  times.estimate = estimate_seconds;
+  return best;
+}
+
+void Enumeration::enumerate_automatic(OptimaSink& sink, size_t threads) {
+  Strategy best = choose_strategy();
+  auto phase_start = std::chrono::steady_clock::now();
+  use_ordering(best.ordering);
+  times.remap += lap(phase_start);
+  std::ostringstream strategy;
+  strategy << "Automatic strategy: hyper " << (best.hyper ? "on" : "off")
+           << " with ordering " << ordering_name(best.ordering)
+           << ", predicted cost " << best.cost << " and seconds "
+           << best.seconds / threads;
+  if (verbose) {
+    cout << strategy.str() << endl;
+  }
+  run(sink, best.hyper, best.ordering, threads, strategy.str());
+  if (verbose) {
+    cout << "Enumerating took " << times.enumerate << " seconds, predicted "
+         << best.seconds / threads << endl;
+  }
+}
+
+void Enumeration::run(OptimaSink& sink, bool hyper, Ordering ordering,
+                      size_t threads, const string& strategy) {
+  if (verbose) {
+    cout << "Using " << delta_kernel_name() << " move updates" << endl;
+  }
+  if (bounding()) {
+    prepare_bounds();
+    shared_threshold = min_fitness;
+  }
+  const bool reorder = ordering != Ordering::none;
+
+  settings = { uint32_t(length), uint32_t(radius), hyper, reorder, all_radii,
+      uint32_t(shard), uint32_t(shards), 0, 0, new_to_org };
+  settings.strategy = strategy;
+  stats = WalkStats();
+  auto phase_start = std::chrono::steady_clock::now();
+  sink.start(settings);
+  size_t count;
+  if (shards > 1) {
+    count = shard_enumerate(sink, hyper, threads);
+  } else if (threads > 1) {
+    // Hyperplane skipping makes subspace costs very uneven, so create
+    // many more subspaces than threads.
+    const int fixed = split_bits(threads * 16);
+    vector<size_t> prefixes(size_t(1) << fixed);
+    std::iota(prefixes.begin(), prefixes.end(), 0);
+    count = parallel_enumerate(sink, hyper, fixed, prefixes, threads);
+  } else {
+    // A single subspace with no fixed bits is the entire search space
+    SearchState state;
+    start_subspace(state, 0, 0);
+    count = enumerate_subspace(state, 0, hyper, sink, true);
+    stats.merge(state.stats);
+  }
+  times.enumerate = lap(phase_start);
+  auto current = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::duration<double>(current - start).count();
+  sink.finish(count, elapsed);
+}
+
+bool Enumeration::resume(OptimaSink& sink, const Checkpoint& checkpoint) {
+  settings = checkpoint.settings;
+  if (settings.length != uint32_t(length)
+      or settings.radius != uint32_t(radius)) {
+    cout << "Checkpoint was for a different length or radius" << endl;
+    return false;
+  }
+  set_all_radii(settings.tagged);
+  // Use the saved ordering instead of recalculating it
+  new_to_org = settings.new_to_org;
+  org_to_new.assign(length, -1);
+  for (int i = 0; i < length; i++) {
+    if (new_to_org[i] < 0 or new_to_org[i] >= length
+        or org_to_new[new_to_org[i]] != -1) {
+      cout << "Checkpoint ordering is invalid" << endl;
+      return false;
+    }
+    org_to_new[new_to_org[i]] = i;
+  }
+  bin_moves();
+  if (bounding()) {
+    prepare_bounds();
+    shared_threshold = min_fitness;
+  }
+  if (not sink.resume(settings, checkpoint.sink_state)) {
+    cout << "This output mode does not support checkpoints" << endl;
+    return false;
+  }
+
+  // Rebuild all of the move information from the saved solution
+  SearchState state;
+  state.reference = checkpoint.reference;
+  initialize_deltas(state);
+  count_improving(state);
+  state.index = checkpoint.index;
+  state.odd = checkpoint.odd;
+  state.count = settings.count;
+  state.visited = 0;
+  // Include time spent before the checkpoint
+  start = std::chrono::steady_clock::now()
+      - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(settings.seconds));
+  cout << "Resuming" << endl;
+  stats = WalkStats();
+  auto phase_start = std::chrono::steady_clock::now();
+  size_t count = enumerate_subspace(state, 0, settings.hyper, sink, true);
+  stats.merge(state.stats);
+  times.enumerate = lap(phase_start);
+  auto current = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::duration<double>(current - start).count();
+  sink.finish(count, elapsed);
+  return true;
+}
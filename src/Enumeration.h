@@ -12,41 +12,241 @@
 
 #include "MKLandscape.h"
 #include "GraphUtilities.h"
+#include "OptimaSink.h"
+#include "Checkpoint.h"
+#include "Ordering.h"
+#include "PackedBits.h"
+#include "DeltaKernels.h"
+#include "StructureCache.h"
 #include <ostream>
 #include <chrono>
+#include <atomic>
+#include <limits>
 
-class Enumeration {
- public:
-  // Set up initial information based on the landscape and the
-  // desired hamming ball radius
-  Enumeration(const MKLandscape & landscape_, size_t radius_);
-  // Perform the landscape enumeration, writing all of the local optima to the
-  // "out" stream.
-  void enumerate(std::ostream& out, bool hyper = true, bool reorder = true);
- protected:
-  const MKLandscape& landscape;
-  int length, radius;
+// Counts of what walks did, only gathered when enabled by "set_stats".
+// Walks which don't gather them are compiled without any of the counting.
+struct WalkStats {
+  // Bits flipped
+  uint64_t flips;
+  // Fitness table lookups made while flipping
+  uint64_t evaluations;
+  // Bits set back to 0 when carrying to the next hyperplane
+  uint64_t carries;
+  // How often the walk skipped every solution below each position
+  vector<uint64_t> skips;
+  // Seconds spent in each pass of a serial walk. Each pass ends when the
+  // next highest position is first set, so the passes cover half,
+  // then a quarter, and so on of the search space.
+  vector<double> pass_seconds;
+  WalkStats()
+      : flips(0),
+        evaluations(0),
+        carries(0) {
+  }
+  // Adds "other" into these totals
+  void merge(const WalkStats& other);
+  // Writes a human readable summary
+  void write(std::ostream& out) const;
+};
+
+// Everything an enumeration walk modifies as it moves through the
+// search space. Each thread owns one of these, while the move tables
+// stored in Enumeration are shared read-only.
+struct SearchState {
   // When enumerating, this stores the current binary string.
   // <char> is used because it ends up being more computationally efficient
   // than <bool>
   vector<char> reference;
+  // The same solution in the remapped ordering, packed 64 positions to a
+  // word (see PackedBits.h). Lets walks test positions without looking
+  // up which variable is there.
+  vector<uint64_t> packed;
   // Quality of the reference solution
   int fitness;
+  // Table storing the fitness effect of making a particular move
+  vector<int> delta;
+  // Keeps track of how many improving moves are in each bin
+  vector<size_t> moves_in_bin;
+  // Count of current number of fitness improving moves
+  int improving_moves;
+  // Current index into each subfunction's fitness table
+  vector<size_t> sub_index;
+  // Position of the last flip in the remapped ordering
+  int index;
+  // tracks parity for the gray code counter
+  bool odd;
+  // tracks how many local optima are found
+  size_t count;
+  // tracks how many solutions were visited
+  uint64_t visited;
+  // Only filled in when gathering stats
+  WalkStats stats;
+  // Only used when walks have a fitness threshold. "bound" is the best
+  // fitness any solution could have if only positions below
+  // "bound_level" were changed, and "free_bits" counts how many of
+  // each subfunction's variables are below "bound_level".
+  int bound;
+  int bound_level;
+  vector<int> free_bits;
+  // Heap of the best fitnesses found when finding the top k optima,
+  // worst at the front
+  vector<int> top_fitness;
+  // Only used when larger moves are checked lazily. "version" changes
+  // with every flip, and "bin_larger" records if any larger move in the
+  // bin was improving when last checked at "bin_checked".
+  uint64_t version;
+  vector<uint64_t> bin_checked;
+  vector<char> bin_larger;
+};
+
+// Seconds spent in each phase of setting up and running an enumeration
+struct PhaseTimes {
+  // Building the variable interaction graph
+  double graph;
+  // Finding all moves of radius or less bits
+  double moves;
+  // Linking bits, moves and subfunctions
+  double tables;
+  // Reordering the variables and binning moves
+  double remap;
+  // Predicting the cost of the ordering, which "enumerate" only does
+  // when verbose
+  double estimate;
+  // Finding the local optima
+  double enumerate;
+};
+
+// Everything that configures an enumeration, with the same defaults as
+// the command line. Each setting is described by the Enumeration method
+// it is passed to.
+struct EnumerationOptions {
+  size_t radius = 1;
+  bool hyper = true;
+  // Ordering::none turns off reordering
+  Ordering ordering = Ordering::moves;
+  size_t threads = 1;
+  size_t shard = 0, shards = 1;
+  int min_fitness = std::numeric_limits<int>::min();
+  size_t top_k = 0;
+  bool all_radii = false;
+  bool lazy = false;
+  // Ignores "hyper" and "ordering", using "enumerate_automatic" instead
+  bool automatic = false;
+  bool stats = false;
+  double progress_seconds = 10;
+  bool verbose = true;
+  // Folder of saved moves and orderings, or empty to not use one
+  string structure_cache;
+};
+
+// One way of enumerating, and how long it is expected to take
+struct Strategy {
+  bool hyper;
+  Ordering ordering;
+  // From "predict_cost"
+  double cost;
+  // Expected seconds for a single thread
+  double seconds;
+};
+
+class Enumeration {
+ public:
+  // Set up initial information based on the landscape and the
+  // desired hamming ball radius, using up to "threads" threads.
+  // If "structure_cache" names a folder, moves and orderings are loaded
+  // from it when possible and saved to it otherwise (see StructureCache.h).
+  Enumeration(const MKLandscape & landscape_, size_t radius_,
+              size_t threads = 1, const string& structure_cache = "");
+  // Uses the radius and threads of "options", then applies the rest
+  // using "set_options"
+  Enumeration(const MKLandscape & landscape_,
+              const EnumerationOptions& options);
+  // Perform the landscape enumeration, giving all of the local optima to
+  // "sink". With more than one thread the search space is split
+  // into subspaces by fixing the highest order bits.
+  // If sharded, only this shard's subspaces are enumerated.
+  void enumerate(OptimaSink& sink, bool hyper = true,
+                 Ordering ordering = Ordering::moves, size_t threads = 1);
+  // Cheaply predicts how many solutions an enumeration using "ordering"
+  // visits, which is roughly proportional to its run time. Uses random
+  // paths through the hyperplanes that would not be skipped.
+  double predict_cost(Ordering ordering, bool hyper = true);
+  // Tries hyperplanes with every ordering, and gray code counting
+  // without reordering, returning the one expected to finish first.
+  // Each one's seconds are its predicted cost times the seconds per unit
+  // of cost measured by walking a few small subspaces with random
+  // values for the highest positions.
+  Strategy choose_strategy();
+  // Like "enumerate", but uses "choose_strategy" to decide how. The
+  // choice and its predicted seconds are written in the output header.
+  void enumerate_automatic(OptimaSink& sink, size_t threads = 1);
+  // Table lookups "make_flip" would make if every variable was flipped
+  // once, if the landscape's subfunctions used "sub_variables" instead.
+  // Used to compare different ways of splitting the same landscape.
+  uint64_t flip_lookups(const FlatLists<size_t>& sub_variables) const;
+  // Continue an enumeration from a checkpoint written by a previous run.
+  // Returns false if the checkpoint doesn't match this landscape.
+  bool resume(OptimaSink& sink, const Checkpoint& checkpoint);
+  // Makes serial enumerations write a checkpoint to "filename" every
+  // "seconds" seconds
+  void set_checkpoint(const string& filename, double seconds);
+  // Only enumerate part "shard_" of the search space when it is split
+  // into "shards_" parts. Every shard must use the same landscape,
+  // radius and settings to get the same split.
+  void set_shard(size_t shard_, size_t shards_);
+  // How long each phase took. Phases which haven't run are 0.
+  const PhaseTimes& phase_times() const {
+    return times;
+  }
+  // Gather WalkStats during enumeration, which slows it down slightly
+  void set_stats(bool enabled);
+  const WalkStats& walk_stats() const {
+    return stats;
+  }
+  // Print a progress line at most once every "seconds" seconds, or never
+  // if "seconds" is 0
+  void set_progress(double seconds);
+  // Only give local optima with at least "min_fitness_" fitness to the
+  // sink. If "top_k_" is not 0, the threshold is also raised to the
+  // fitness of the k-th best optimum found so far. Hyperplanes whose
+  // fitness bound is below the threshold are skipped.
+  void set_threshold(int min_fitness_, size_t top_k_);
+  // Instead of only finding "radius" bit local optima, find all 1-bit
+  // local optima and tag each with the largest radius up to "radius" at
+  // which it is still a local optimum. Walks only track single bit moves,
+  // and larger moves are only checked at each 1-bit local optimum.
+  void set_all_radii(bool enabled);
+  // Walks only keep the fitness effect of single bit moves up to date.
+  // Larger moves are only checked once no single bit move improves, or
+  // when deciding if a hyperplane can be skipped. Usually faster for
+  // radius 2 and up, and finds the same local optima.
+  void set_lazy(bool enabled);
+  // Turns off the messages describing how the enumeration is set up
+  void set_verbose(bool enabled);
+  // Applies the shard, threshold, all radii, stats, progress and verbose
+  // settings of "options". The rest are given to "enumerate".
+  void set_options(const EnumerationOptions& options);
+ protected:
+  const MKLandscape& landscape;
+  int length, radius;
   // List of all moves, which are just collections of indices
-  vector<vector<size_t>> moves;
+  FlatLists<size_t> moves;
   // Indices of single bit moves in the "moves" vector
   vector<size_t> single_bit_moves;
-  // Lookup tables to find which moves effect what subfunctions, and vice versa
-  vector<unordered_set<size_t>> move_to_sub, sub_to_move;
-  vector<vector<size_t>> bit_to_sub;
+  // Lookup tables to find which moves effect what subfunctions, and vice
+  // versa, including how the move changes the subfunction's table index.
+  // Rows are sorted by index.
+  FlatLists<IndexMask> move_to_sub, sub_to_move;
+  // For each bit, the subfunctions it is in and how it changes their index
+  FlatLists<IndexMask> bit_to_sub;
   // For each move, figure out which bin it goes into
   vector<size_t> move_to_bin;
-  // Keeps track of how many improving moves are in each bin
-  vector<size_t> moves_in_bin;
-  // Table storing the fitness effect of making a particular move
-  vector<int> delta;
-  // Count of current number of fitness improving moves
-  int improving_moves;
+  // Every subfunction's fitness table, stored contiguously by the landscape
+  const FlatLists<int>& tables;
+  // Number of variables in every subfunction, or 0 if they differ
+  int arity;
+  // Where moves and orderings are saved between runs, if anywhere
+  StructureCache structure;
 
   // Conversion lookups between the original index ordering and the
   // remapped ordering
@@ -54,20 +254,146 @@ class Enumeration {
 
   // Time stamp of when the class was first given the landscape
   std::chrono::steady_clock::time_point start;
+  PhaseTimes times;
+  // Description of the current enumeration, given to sinks and checkpoints
+  OptimaHeader settings;
+  // Where and how often checkpoints are written, if at all
+  string checkpoint_file;
+  double checkpoint_seconds;
+  // Which part of the search space to enumerate
+  size_t shard, shards;
+  // Totals of every walk, if they are being gathered
+  bool gather_stats;
+  WalkStats stats;
+  double progress_seconds;
+  // Lowest fitness of any optimum the sink wants, and how many of the
+  // best optima are wanted, or 0 for all of them
+  int min_fitness;
+  size_t top_k;
+  // If optima are tagged with their radius
+  bool all_radii;
+  bool verbose;
+  // Checks larger moves lazily (see "set_lazy")
+  bool lazy;
+  // Moves of more than one bit from smallest to largest, which are only
+  // used when tagging radii or checking lazily
+  vector<size_t> larger_moves;
+  // "larger_moves" grouped by bin, only filled in when checking lazily
+  FlatLists<uint32_t> larger_in_bin;
+  // Highest k-th best fitness found by any walk
+  mutable std::atomic<int> shared_threshold;
+  // For each subfunction, (K + 1) copies of its table. In copy "c", each
+  // entry is the best value reachable by changing only the "c" variables
+  // with the lowest remapped positions.
+  FlatLists<int> best_tables;
 
   // Construct all of the initial fitness effects of making moves
-  void initialize_deltas();
-  // Flip all of the bits associated with a given move
-  void flip_move(size_t move_index);
+  void initialize_deltas(SearchState& state) const;
   // Flips a given bit and updates all deltas and move_bin counts
-  int make_flip(size_t index);
+  int make_flip(SearchState& state, size_t index) const;
+
+  // Walks and flips are specialized on the number of variables "K" in
+  // each subfunction, so table lookups use a fixed stride. A "K" of 0
+  // works with any subfunction sizes. They only count WalkStats if
+  // "Stats" is true, and walks only use a fitness threshold if "Bound"
+  // is true.
+  template<int K>
+  const int* table(size_t subfunction) const;
+  template<int K, bool Stats>
+  int flip(SearchState& state, size_t index) const;
+  template<int K, bool Stats, bool Bound>
+  size_t walk(SearchState& state, int fixed, bool hyper, OptimaSink& sink,
+              bool show_progress) const;
+  // Versions of "flip" and "walk" which match "arity", "gather_stats"
+  // and "bounding".
+  // Flips made outside of walks are never counted.
+  int (Enumeration::*flip_kernel)(SearchState&, size_t) const;
+  size_t (Enumeration::*walk_kernel)(SearchState&, int, bool, OptimaSink&,
+                                     bool) const;
+  template<int K>
+  void use_kernels();
+  void select_kernels();
+  // Vectorized update of the moves overlapping a flipped subfunction,
+  // or nullptr if the CPU doesn't support one
+  DeltaKernel delta_kernel;
 
   // Performs the reordering of how enumeration is performed
   // to improve hyperplane skipping
-  void remap();
-  // Figure out what bin each move should be placed in, and set
-  // up initial bin counts
+  void remap(Ordering ordering);
+  // Sets up "ordering" and the move bins, loading them from the
+  // structure cache if possible
+  void use_ordering(Ordering ordering);
+  // Figure out what bin each move should be placed in
   void bin_moves();
+  // Builds "larger_in_bin" from "move_to_bin"
+  void group_larger_moves();
+  // Set up the bin counts of a state based on its current deltas
+  void count_improving(SearchState& state) const;
+  // Builds "sub_to_move" from "move_to_sub", only including the moves
+  // walks need to track
+  void link_moves();
+  // Largest radius at which a 1-bit local optimum is still locally optimal
+  int optimum_radius(const SearchState& state) const;
+  // Fitness effect of making "move", found from the subfunction indices
+  int move_delta(const SearchState& state, size_t move) const;
+  // True if larger moves are only checked when needed
+  bool lazy_larger() const;
+  // True if any larger move in "bin" is improving, which is remembered
+  // until the next flip
+  bool larger_improving(SearchState& state, int bin) const;
+  bool any_larger_improving(SearchState& state) const;
+  // True if "bin" has no improving moves, including lazy larger moves
+  bool bin_open(SearchState& state, int bin) const;
+
+  // True if walks use a fitness threshold
+  bool bounding() const;
+  // Builds "best_tables" for the current ordering
+  void prepare_bounds();
+  // Moves "state.bound" to "level", one position at a time
+  void set_bound_level(SearchState& state, int level) const;
+  // Updates "state.bound" after the bit at "position" was flipped
+  void bound_flip(SearchState& state, int position) const;
+  // Records the fitness of an optimum when finding the top k, returning
+  // the raised threshold
+  int raise_threshold(SearchState& state, int threshold) const;
+
+  // Sets "state" to the first solution of a subspace, where the "fixed"
+  // highest order bits (in the remapped ordering) are taken from "prefix"
+  // and all other bits are 0.
+  void start_subspace(SearchState& state, size_t prefix, int fixed) const;
+  // Sets up the rest of "state" to start walking from "state.reference"
+  void start_walk(SearchState& state) const;
+  // Walks every solution in the subspace "state" was started in, giving
+  // local optima to "sink". Returns how many local optima were found.
+  size_t enumerate_subspace(SearchState& state, int fixed, bool hyper,
+                            OptimaSink& sink, bool show_progress) const;
+  // Predicts how many solutions a walk of a subspace visits by averaging
+  // "probes" random paths through the hyperplanes it doesn't skip.
+  // Only depends on the landscape and settings.
+  double estimate_subspace(size_t prefix, int fixed, bool hyper,
+                           size_t probes) const;
+  // The same for the subspace "state" was started in, using "seed" to
+  // choose the paths. Leaves "state" where it started.
+  double estimate_walk(SearchState& state, int fixed, bool hyper,
+                       size_t probes, uint32_t seed) const;
+  // Estimates how much of a subspace a walk has finished from the
+  // positions it has set
+  double covered(const SearchState& state, int limit, bool hyper) const;
+  // Records the progress of a serial walk in "checkpoint_file"
+  void save_checkpoint(const SearchState& state, OptimaSink& sink) const;
+  // Smallest number of fixed bits which makes at least "parts" subspaces
+  int split_bits(size_t parts) const;
+  // Splits "prefixes" between "threads" workers which steal
+  // subspaces from each other as they run out of work.
+  size_t parallel_enumerate(OptimaSink& sink, bool hyper, int fixed,
+                            const vector<size_t>& prefixes, size_t threads);
+  // Enumerates this shard's subspaces, which are chosen to give each
+  // shard a similar amount of estimated work.
+  size_t shard_enumerate(OptimaSink& sink, bool hyper, size_t threads);
+  // Finds the local optima once the ordering is set up, writing
+  // "strategy" in the header if it isn't empty
+  void run(OptimaSink& sink, bool hyper, Ordering ordering, size_t threads,
+           const string& strategy);
 };
 
 #endif /* ENUMERATION_H_ */
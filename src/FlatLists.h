@@ -0,0 +1,104 @@
+// Brian Goldman
+
+// Compact storage for many short lists, such as moves, subfunction
+// variables and fitness tables.
+
+#ifndef FLATLISTS_H_
+#define FLATLISTS_H_
+
+#include <vector>
+using std::vector;
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+
+// Compressed sparse row storage for a list of lists. All entries live in
+// one contiguous array, with row "r" stored between offsets[r] and
+// offsets[r + 1]. Rows are either appended in order using "add_row", or
+// filled in any order by first calling "count" for every entry, then
+// "allocate", then "add" for every entry.
+template<class T>
+class FlatLists {
+ public:
+  // Read only view of a single row
+  struct Row {
+    const T* first;
+    const T* last;
+    const T* begin() const {
+      return first;
+    }
+    const T* end() const {
+      return last;
+    }
+    size_t size() const {
+      return last - first;
+    }
+    const T& operator[](size_t i) const {
+      return first[i];
+    }
+  };
+  explicit FlatLists(size_t rows = 0)
+      : offsets(rows + 1, 0) {
+  }
+  inline Row operator[](size_t row) const {
+    return {entries.data() + offsets[row], entries.data() + offsets[row + 1]};
+  }
+  inline size_t size() const {
+    return offsets.size() - 1;
+  }
+  inline size_t total() const {
+    return entries.size();
+  }
+  // All entries of all rows, in order
+  inline const T* data() const {
+    return entries.data();
+  }
+  // Where each row starts in "data", followed by the total
+  inline const uint32_t* row_starts() const {
+    return offsets.data();
+  }
+
+  // Replaces everything with "rows" rows copied from arrays laid out
+  // like "row_starts" and "data"
+  void assign(size_t rows, const uint32_t* starts, const T* values) {
+    offsets.assign(starts, starts + rows + 1);
+    entries.assign(values, values + offsets.back());
+    filled.clear();
+  }
+
+  // Appends a new row to the end
+  template<class Iterator>
+  void add_row(Iterator begin, Iterator end) {
+    entries.insert(entries.end(), begin, end);
+    offsets.push_back(entries.size());
+  }
+  // Appends all of the rows in "other" to the end
+  void append(const FlatLists<T>& other) {
+    const uint32_t shift = entries.size();
+    entries.insert(entries.end(), other.entries.begin(), other.entries.end());
+    for (size_t row = 1; row < other.offsets.size(); row++) {
+      offsets.push_back(other.offsets[row] + shift);
+    }
+  }
+  // Reserves space in "row" for one more entry
+  void count(size_t row) {
+    offsets[row + 1]++;
+  }
+  // Converts the counts into row locations
+  void allocate() {
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    entries.resize(offsets.back());
+    filled.assign(offsets.begin(), offsets.end() - 1);
+  }
+  // Adds "value" to the next free space in "row"
+  void add(size_t row, const T& value) {
+    entries[filled[row]++] = value;
+  }
+ private:
+  vector<uint32_t> offsets;
+  vector<T> entries;
+  // Next free space in each row while filling
+  vector<uint32_t> filled;
+};
+
+#endif /* FLATLISTS_H_ */
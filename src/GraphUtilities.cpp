@@ -3,6 +3,9 @@
 // Tools for converting an MK Landscape into a variable interaction graph
 // and then finding all moves in the r-bit hamming ball.
 #include "GraphUtilities.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 vector<unordered_set<size_t>> build_graph(const MKLandscape& landscape) {
   vector<unordered_set<size_t>> graph(landscape.get_length(),
@@ -21,51 +24,162 @@ vector<unordered_set<size_t>> build_graph(const MKLandscape& landscape) {
   return graph;
 }
 
-// Finds all possible connected induced subgraphs with k or less vertices
-vector<vector<size_t>> k_order_subgraphs(
-    const vector<unordered_set<size_t>>& graph, size_t radius) {
-  // The list of all subgraphs found so far.
-  vector<vector<size_t>> found;
-  unordered_set<size_t> closed, prevopen;
-  // Vertices already in the set, initially empty
-  vector<size_t> prev;
-  // Call the recursive function starting at each vertex
-  for (size_t v = 0; v < graph.size(); v++) {
-    closed.insert(v);
-    recurse(graph, v, closed, prev, prevopen, radius, found);
+vector<vector<size_t>> connected_components(
+    const vector<unordered_set<size_t>>& graph) {
+  vector<vector<size_t>> components;
+  vector<char> seen(graph.size(), false);
+  for (size_t start = 0; start < graph.size(); start++) {
+    if (seen[start]) {
+      continue;
+    }
+    // Breadth first search, using the component itself as the queue
+    seen[start] = true;
+    vector<size_t> component(1, start);
+    for (size_t i = 0; i < component.size(); i++) {
+      for (const auto& neighbor : graph[component[i]]) {
+        if (not seen[neighbor]) {
+          seen[neighbor] = true;
+          component.push_back(neighbor);
+        }
+      }
+    }
+    std::sort(component.begin(), component.end());
+    components.push_back(component);
   }
-  return found;
+  return components;
 }
 
-// Recursive function used by k_order_subgraphs to expand each subset by "v"
-// and then find all possible subgraphs which contain "prev" and "v"
-void recurse(const vector<unordered_set<size_t>>& graph, size_t v,
-             unordered_set<size_t> & closed, vector<size_t> & prev,
-             unordered_set<size_t> & prevopen, size_t radius,
-             vector<vector<size_t>> & found) {
-  // Create a new subset containing "prev" and "v"
-  vector<size_t> inset(prev);
-  inset.push_back(v);
-  found.push_back(inset);
-  // Add that subset to "found"
-  if (inset.size() >= radius) {
-    return;
+namespace {
+// Working space for finding subgraphs, which is reused so nothing is
+// allocated per subgraph. Each level of the search adds one vertex.
+struct SubgraphSearch {
+  SubgraphSearch(size_t length)
+      : closed(length, false),
+        listed(length, false) {
   }
+  // Vertices which cannot be added to the current subgraph
+  vector<char> closed;
+  // Vertices already stored in "open"
+  vector<char> listed;
+  // Vertices adjacent to the current subgraph. Each level only
+  // appends the neighbors of the vertex it added.
+  vector<size_t> open;
+  // Vertices closed by each level, to be reopened when it finishes
   vector<size_t> closed_here;
-  // open everything adjacent to v
-  unordered_set<size_t> openset(prevopen);
-  const auto & adjacent = graph.at(v);
-  openset.insert(adjacent.begin(), adjacent.end());
-  // recurse using each not-closed option
-  for (const auto& working : openset) {
-    if (closed.count(working) == 0) {
-      closed_here.push_back(working);
-      closed.insert(working);
-      recurse(graph, working, closed, inset, openset, radius, found);
+  // The current subgraph
+  vector<size_t> inset;
+  // For each level, where its part of "open" ends, the next position
+  // in "open" to try adding, and where its part of "closed_here" starts
+  vector<size_t> open_end, next, closed_start;
+
+  // Starts a new level which extends the subgraph by "vertex"
+  void push(const FlatLists<size_t>& adjacency, size_t vertex) {
+    inset.push_back(vertex);
+    for (const auto& neighbor : adjacency[vertex]) {
+      if (not listed[neighbor]) {
+        listed[neighbor] = true;
+        open.push_back(neighbor);
+      }
+    }
+    open_end.push_back(open.size());
+    next.push_back(0);
+    closed_start.push_back(closed_here.size());
+  }
+  // Undoes everything done by the deepest level
+  void pop() {
+    for (size_t i = closed_start.back(); i < closed_here.size(); i++) {
+      closed[closed_here[i]] = false;
+    }
+    closed_here.resize(closed_start.back());
+    size_t levels = open_end.size();
+    size_t open_start = levels > 1 ? open_end[levels - 2] : 0;
+    for (size_t i = open_start; i < open.size(); i++) {
+      listed[open[i]] = false;
     }
+    open.resize(open_start);
+    inset.pop_back();
+    open_end.pop_back();
+    next.pop_back();
+    closed_start.pop_back();
+  }
+};
+
+// Adds every subgraph whose lowest vertex is "v" to "found". Each
+// subgraph is found once, as vertices are closed after every subgraph
+// which could contain them has been tried.
+void subgraphs_from(const FlatLists<size_t>& adjacency, size_t v,
+                    size_t radius, SubgraphSearch& search,
+                    FlatLists<size_t>& found) {
+  found.add_row(&v, &v + 1);
+  if (radius <= 1) {
+    return;
+  }
+  search.push(adjacency, v);
+  while (search.inset.size()) {
+    size_t level = search.inset.size() - 1;
+    if (search.next[level] == search.open_end[level]) {
+      // Every option at this level has been tried
+      search.pop();
+      continue;
+    }
+    size_t working = search.open[search.next[level]++];
+    // Lower vertices were already used as starting points
+    if (working <= v or search.closed[working]) {
+      continue;
+    }
+    search.closed[working] = true;
+    search.closed_here.push_back(working);
+    search.inset.push_back(working);
+    found.add_row(search.inset.begin(), search.inset.end());
+    search.inset.pop_back();
+    if (search.inset.size() + 1 < radius) {
+      search.push(adjacency, working);
+    }
+  }
+}
+}
+
+// Finds all possible connected induced subgraphs with k or less vertices
+FlatLists<size_t> k_order_subgraphs(
+    const vector<unordered_set<size_t>>& graph, size_t radius,
+    size_t threads) {
+  // Sorted neighbors make the search order deterministic
+  FlatLists<size_t> adjacency;
+  vector<size_t> neighbors;
+  for (const auto& edges : graph) {
+    neighbors.assign(edges.begin(), edges.end());
+    std::sort(neighbors.begin(), neighbors.end());
+    adjacency.add_row(neighbors.begin(), neighbors.end());
+  }
+  const size_t length = graph.size();
+  // Low vertices start many more subgraphs than high vertices, so
+  // split the starting vertices into many chunks which threads take
+  // as they finish.
+  const size_t chunks = std::min(length, threads * 32);
+  vector<FlatLists<size_t>> found(chunks);
+  std::atomic<size_t> next_chunk(0);
+  auto worker = [&]() {
+    SubgraphSearch search(length);
+    size_t chunk;
+    while ((chunk = next_chunk++) < chunks) {
+      size_t end = (chunk + 1) * length / chunks;
+      for (size_t v = chunk * length / chunks; v < end; v++) {
+        subgraphs_from(adjacency, v, radius, search, found[chunk]);
+      }
+    }
+  };
+  vector<std::thread> pool;
+  for (size_t id = 1; id < threads; id++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
   }
-  // reopen anything closed at this level
-  for (const auto& working : closed_here) {
-    closed.erase(working);
+  // Combine chunks in order of their starting vertices
+  FlatLists<size_t> subgraphs;
+  for (const auto& chunk : found) {
+    subgraphs.append(chunk);
   }
+  return subgraphs;
 }
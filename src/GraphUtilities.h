@@ -8,6 +8,7 @@
 #define GRAPHUTILITIES_H_
 
 #include "MKLandscape.h"
+#include "FlatLists.h"
 #include <vector>
 using std::vector;
 #include <unordered_set>
@@ -16,14 +17,16 @@ using std::unordered_set;
 // Constructs a sparse graph from the variable interaction tables of the evaluator
 vector<unordered_set<size_t>> build_graph(const MKLandscape& evaluator);
 
-// Finds all connected induced subgraphs with "radius" or less vertices.
-vector<vector<size_t>> k_order_subgraphs(
-    const vector<unordered_set<size_t>>& graph, size_t radius);
+// Groups the vertices of "graph" into connected components. Each
+// component is sorted, and components are ordered by their lowest vertex.
+vector<vector<size_t>> connected_components(
+    const vector<unordered_set<size_t>>& graph);
 
-// Recursive function used internally by k_order_subgraphs.
-void recurse(const vector<unordered_set<size_t>>& graph, size_t v,
-             unordered_set<size_t> & closed, vector<size_t> & prev,
-             unordered_set<size_t> & prevopen, size_t radius,
-             vector<vector<size_t>> & found);
+// Finds all connected induced subgraphs with "radius" or less vertices,
+// using up to "threads" threads. Subgraphs are grouped by their lowest
+// vertex, so the result does not depend on the number of threads.
+FlatLists<size_t> k_order_subgraphs(
+    const vector<unordered_set<size_t>>& graph, size_t radius,
+    size_t threads = 1);
 
 #endif /* GRAPHUTILITIES_H_ */
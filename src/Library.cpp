@@ -0,0 +1,83 @@
+// Brian Goldman
+
+// Implements the entry points used by programs linking against libMKL.a
+
+#include "Library.h"
+#include "OptimaSummary.h"
+#include <iostream>
+
+// Nothing is gathered, so each optimum goes straight to the visitor
+class VisitorSink::VisitorBlock : public Block {
+ public:
+  VisitorBlock(VisitorSink& sink_)
+      : sink(sink_) {
+  }
+  void add(int fitness, const vector<char>& solution,
+           const vector<uint64_t>&, int radius) override {
+    std::lock_guard<std::mutex> lock(sink.guard);
+    // Other threads may find a few more before they notice the stop
+    if (sink.stop) {
+      return;
+    }
+    sink.calls++;
+    if (not sink.visitor(fitness, solution, radius)) {
+      sink.stop = true;
+    }
+  }
+  void submit() override {
+  }
+ private:
+  VisitorSink& sink;
+};
+
+VisitorSink::VisitorSink(OptimaVisitor visitor_)
+    : visitor(visitor_),
+      stop(false),
+      calls(0) {
+}
+
+void VisitorSink::start(const OptimaHeader& header) {
+  stop = false;
+  calls = 0;
+}
+
+std::unique_ptr<OptimaSink::Block> VisitorSink::make_block() {
+  return std::unique_ptr<Block>(new VisitorBlock(*this));
+}
+
+void VisitorSink::finish(size_t count, double seconds) {
+}
+
+bool VisitorSink::stopped() const {
+  return stop;
+}
+
+bool enumerate_optima(const MKLandscape& landscape,
+                      const EnumerationOptions& options, OptimaSink& sink) {
+  if (options.all_radii and options.top_k) {
+    std::cerr << "The best optima are kept without their radius, so "
+              << "all_radii can't be used with top_k" << std::endl;
+    return false;
+  }
+  Enumeration find_local(landscape, options);
+  // Keeps only the best optima, then hands them to "sink"
+  std::unique_ptr<OptimaSink> top;
+  if (options.top_k) {
+    top.reset(new TopSink(sink, options.top_k));
+  }
+  if (options.automatic) {
+    find_local.enumerate_automatic(top ? *top : sink, options.threads);
+  } else {
+    find_local.enumerate(top ? *top : sink, options.hyper, options.ordering,
+                         options.threads);
+  }
+  return true;
+}
+
+size_t enumerate_optima(const MKLandscape& landscape,
+                        const EnumerationOptions& options,
+                        OptimaVisitor visitor) {
+  VisitorSink sink(visitor);
+  enumerate_optima(landscape, options, sink);
+  return sink.visited();
+}
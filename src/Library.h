@@ -0,0 +1,71 @@
+// Brian Goldman
+
+// Entry points for programs which link against the enumerator (libMKL.a)
+// instead of running MKL and parsing its output. For example:
+//
+//   MKLandscape landscape(length, variables, tables);
+//   EnumerationOptions options;
+//   options.radius = 2;
+//   options.verbose = false;
+//   options.progress_seconds = 0;
+//   enumerate_optima(landscape, options,
+//                    [](int fitness, const vector<char>& solution, int) {
+//                      // Return false to stop early
+//                      return fitness < 100;
+//                    });
+
+#ifndef LIBRARY_H_
+#define LIBRARY_H_
+
+#include "MKLandscape.h"
+#include "Enumeration.h"
+#include "OptimaSink.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// Called with each local optimum's fitness, its solution, and the largest
+// radius it is a local optimum at (only found with "all_radii", otherwise
+// the enumeration's radius). The solution is the enumeration's own
+// vector, so it is only valid during the call. Returning false stops the
+// enumeration.
+typedef std::function<bool(int fitness, const vector<char>& solution,
+                           int radius)> OptimaVisitor;
+
+// Hands every local optimum straight to a visitor without storing it.
+// Calls are never made at the same time, but with multiple threads they
+// may come from different threads.
+class VisitorSink : public OptimaSink {
+ public:
+  VisitorSink(OptimaVisitor visitor_);
+  void start(const OptimaHeader& header) override;
+  std::unique_ptr<Block> make_block() override;
+  void finish(size_t count, double seconds) override;
+  bool stopped() const override;
+  // How many local optima were given to the visitor
+  inline size_t visited() const {
+    return calls;
+  }
+ private:
+  class VisitorBlock;
+  OptimaVisitor visitor;
+  std::mutex guard;
+  std::atomic<bool> stop;
+  size_t calls;
+};
+
+// Finds the local optima of "landscape" using "options", giving them to
+// "sink". With "options.top_k" only the best are given, once the
+// enumeration finishes. Returns false without enumerating if the options
+// can't be used together, which like the command line includes
+// "all_radii" with "top_k", as the best optima are kept without their
+// radius.
+bool enumerate_optima(const MKLandscape& landscape,
+                      const EnumerationOptions& options, OptimaSink& sink);
+// As above, giving each local optimum to "visitor". Returns how many
+// were visited, which is 0 if the options can't be used together.
+size_t enumerate_optima(const MKLandscape& landscape,
+                        const EnumerationOptions& options,
+                        OptimaVisitor visitor);
+
+#endif /* LIBRARY_H_ */
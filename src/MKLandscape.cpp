@@ -5,72 +5,532 @@
 // each of which read at most k problem variables.
 
 #include "MKLandscape.h"
+#include "GraphUtilities.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <sstream>
-#include <cassert>
-
-MKLandscape::MKLandscape(string filename)
-    : length(0) {
-  std::ifstream input(filename);
-  string line;
-  // First character of the line is used to specify its purpose
-  char head;
-  while (getline(input, line)) {
+#include <iterator>
+#include <numeric>
+#include <utility>
+
+namespace {
+// Text parsing works directly on the file's bytes. "end" is always the
+// end of the current line.
+inline bool is_space(char c) {
+  return c == ' ' or c == '\t' or c == '\r' or c == '\v' or c == '\f';
+}
+
+inline bool is_digit(char c) {
+  return c >= '0' and c <= '9';
+}
+
+inline const char* skip_spaces(const char* p, const char* end) {
+  while (p < end and is_space(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// Reads a non-negative integer, returning false if there isn't one
+bool read_index(const char*& p, const char* end, size_t& value) {
+  p = skip_spaces(p, end);
+  if (p == end or not is_digit(*p)) {
+    return false;
+  }
+  value = 0;
+  while (p < end and is_digit(*p)) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  return true;
+}
+
+// Reads a fitness value, returning false if there isn't one. Values are
+// almost always integers, but anything else "strtod" accepts is also
+// allowed and truncated toward zero.
+bool read_value(const char*& p, const char* end, int& value) {
+  p = skip_spaces(p, end);
+  const char* token = p;
+  bool negative = p < end and *p == '-';
+  if (p < end and (*p == '-' or *p == '+')) {
+    p++;
+  }
+  const char* digits = p;
+  long long magnitude = 0;
+  while (p < end and is_digit(*p) and p - digits < 18) {
+    magnitude = magnitude * 10 + (*p - '0');
+    p++;
+  }
+  if (p > digits and (p == end or is_space(*p))) {
+    value = negative ? -magnitude : magnitude;
+    return true;
+  }
+  // The file isn't null terminated, so copy the token before parsing
+  const char* token_end = token;
+  while (token_end < end and not is_space(*token_end)) {
+    token_end++;
+  }
+  char buffer[64];
+  size_t length = std::min<size_t>(token_end - token, sizeof(buffer) - 1);
+  std::memcpy(buffer, token, length);
+  buffer[length] = 0;
+  char* parsed;
+  double number = std::strtod(buffer, &parsed);
+  if (parsed == buffer) {
+    p = token;
+    return false;
+  }
+  value = number;
+  p = token + (parsed - buffer);
+  return true;
+}
+
+// Copies nested lists into contiguous storage
+template<class T>
+FlatLists<T> flatten(const vector<vector<T>>& lists) {
+  FlatLists<T> flat;
+  for (const auto& list : lists) {
+    flat.add_row(list.begin(), list.end());
+  }
+  return flat;
+}
+
+// Cache files store the parsed arrays exactly as they are held in
+// memory, so they are only meant to be read on the machine that wrote
+// them. The header is followed by the number of variables in each
+// subfunction, then all of the variables, then all of the fitness values.
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  // Size and modification time of the text file this was made from
+  uint64_t source_size;
+  int64_t source_modified;
+  uint64_t length;
+  uint64_t subfunctions;
+  uint64_t variables;
+  uint64_t values;
+};
+const char cache_magic[4] = { 'M', 'K', 'L', 'C' };
+const uint32_t cache_version = 1;
+// Limits table sizes to something that fits in memory
+const size_t max_variables = 30;
+}
+
+MKLandscape::MKLandscape(string filename, bool use_cache)
+    : length(0),
+      loaded(false) {
+  MappedFile file(filename);
+  if (not file.valid()) {
+    std::cerr << "Unable to read " << filename << std::endl;
+    return;
+  }
+  const string cache = cache_filename(filename);
+  bool cached = use_cache
+      and read_cache(cache, file.size(), file.modified());
+  if (not cached) {
+    // Throw away anything a rejected cache left behind
+    length = 0;
+    variables = FlatLists<size_t>();
+    tables = FlatLists<int>();
+    if (not parse(file.data(), file.size())) {
+      std::cerr << "Unable to parse " << filename << std::endl;
+      return;
+    }
+  }
+  if (not check()) {
+    std::cerr << filename << " is not a valid landscape" << std::endl;
+    return;
+  }
+  if (use_cache and not cached) {
+    write_cache(cache, file.size(), file.modified());
+  }
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    subfunctions.push_back({variables[sub], tables[sub]});
+  }
+  loaded = true;
+}
+
+MKLandscape::MKLandscape(size_t length_, FlatLists<size_t> variables_,
+                         FlatLists<int> tables_)
+    : length(length_),
+      variables(std::move(variables_)),
+      tables(std::move(tables_)),
+      loaded(false) {
+  if (not check()) {
+    std::cerr << "Subfunctions do not form a valid landscape" << std::endl;
+    return;
+  }
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    subfunctions.push_back({variables[sub], tables[sub]});
+  }
+  loaded = true;
+}
+
+MKLandscape::MKLandscape(size_t length_,
+                         const vector<vector<size_t>>& variables_,
+                         const vector<vector<int>>& tables_)
+    : MKLandscape(length_, flatten(variables_), flatten(tables_)) {
+}
+
+string MKLandscape::cache_filename(const string& filename) {
+  return filename + ".cache";
+}
+
+size_t MKLandscape::merge_subfunctions(size_t max_arity) {
+  // Merged tables must still be small enough to load
+  max_arity = std::min(max_arity, max_variables);
+  auto graph = build_graph(*this);
+  // Larger subfunctions are placed first so smaller ones can join them
+  vector<size_t> order(variables.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return variables[a].size() > variables[b].size();
+  });
+  // Each group becomes one subfunction over the sorted "group_variables"
+  vector<vector<size_t>> members, group_variables;
+  // Groups holding a table which uses a variable more than once, which
+  // are left alone
+  vector<char> repeated;
+  // Groups using each variable, which are the only ones a subfunction
+  // using that variable can join
+  vector<vector<size_t>> variable_to_group(length);
+  // Last subfunction each group was considered for
+  vector<size_t> seen;
+  vector<size_t> sorted, joined;
+  for (const auto& sub : order) {
+    sorted.assign(variables[sub].begin(), variables[sub].end());
+    std::sort(sorted.begin(), sorted.end());
+    bool repeats = std::adjacent_find(sorted.begin(), sorted.end())
+        != sorted.end();
+    size_t best = members.size(), best_size = 0;
+    if (sorted.empty()) {
+      // A constant can be added to anything
+      for (size_t group = 0; group < members.size(); group++) {
+        if (not repeated[group]) {
+          best = group;
+          best_size = group_variables[group].size();
+          break;
+        }
+      }
+    }
+    for (size_t i = 0; i < sorted.size() and not repeats; i++) {
+      for (const auto& group : variable_to_group[sorted[i]]) {
+        if (seen[group] == sub) {
+          continue;
+        }
+        seen[group] = sub;
+        const auto& existing = group_variables[group];
+        joined.clear();
+        std::set_union(existing.begin(), existing.end(), sorted.begin(),
+                       sorted.end(), std::back_inserter(joined));
+        if (joined.size() == existing.size()) {
+          // Contained within the group, which is always the best choice
+          best = group;
+          best_size = joined.size();
+          break;
+        }
+        if (joined.size() > max_arity
+            or (best < members.size() and joined.size() >= best_size)) {
+          continue;
+        }
+        // Only join if every new variable interacts with all of the group
+        bool clique = true;
+        for (const auto& variable : sorted) {
+          for (const auto& other : existing) {
+            if (variable != other and graph[variable].count(other) == 0) {
+              clique = false;
+            }
+          }
+        }
+        if (clique) {
+          best = group;
+          best_size = joined.size();
+        }
+      }
+      if (best < members.size() and best_size == group_variables[best].size()) {
+        break;
+      }
+    }
+    if (best == members.size()) {
+      members.emplace_back(1, sub);
+      group_variables.push_back(sorted);
+      seen.push_back(sub);
+      repeated.push_back(repeats);
+      if (not repeats) {
+        for (const auto& variable : sorted) {
+          variable_to_group[variable].push_back(best);
+        }
+      }
+      continue;
+    }
+    members[best].push_back(sub);
+    auto& existing = group_variables[best];
+    if (existing.size() < best_size) {
+      joined.clear();
+      std::set_union(existing.begin(), existing.end(), sorted.begin(),
+                     sorted.end(), std::back_inserter(joined));
+      for (const auto& variable : joined) {
+        if (not std::binary_search(existing.begin(), existing.end(),
+                                   variable)) {
+          variable_to_group[variable].push_back(best);
+        }
+      }
+      existing.swap(joined);
+    }
+  }
+  const size_t removed = variables.size() - members.size();
+  if (removed == 0) {
+    return 0;
+  }
+  // Keep the subfunctions in their original order as much as possible
+  vector<size_t> groups(members.size());
+  std::iota(groups.begin(), groups.end(), 0);
+  for (auto& group : members) {
+    std::sort(group.begin(), group.end());
+  }
+  std::sort(groups.begin(), groups.end(), [&members](size_t a, size_t b) {
+    return members[a][0] < members[b][0];
+  });
+  FlatLists<size_t> merged_variables;
+  FlatLists<int> merged_tables;
+  vector<int> values;
+  vector<size_t> shift;
+  for (const auto& group : groups) {
+    const auto& combined = group_variables[group];
+    if (members[group].size() == 1) {
+      // Nothing to sum, so keep the table as it was
+      const size_t sub = members[group][0];
+      merged_variables.add_row(variables[sub].begin(), variables[sub].end());
+      merged_tables.add_row(tables[sub].begin(), tables[sub].end());
+      continue;
+    }
+    const size_t size = combined.size();
+    values.assign(size_t(1) << size, 0);
+    for (const auto& sub : members[group]) {
+      // Where each of the subfunction's variables is in the combined index
+      shift.clear();
+      for (const auto& variable : variables[sub]) {
+        size_t position = std::lower_bound(combined.begin(), combined.end(),
+                                           variable) - combined.begin();
+        shift.push_back(size - position - 1);
+      }
+      for (size_t index = 0; index < values.size(); index++) {
+        size_t sub_index = 0;
+        for (const auto& bit : shift) {
+          sub_index = (sub_index << 1) | ((index >> bit) & 1);
+        }
+        values[index] += tables[sub][sub_index];
+      }
+    }
+    merged_variables.add_row(combined.begin(), combined.end());
+    merged_tables.add_row(values.begin(), values.end());
+  }
+  variables = std::move(merged_variables);
+  tables = std::move(merged_tables);
+  subfunctions.clear();
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    subfunctions.push_back({variables[sub], tables[sub]});
+  }
+  return removed;
+}
+
+bool MKLandscape::parse(const char* text, size_t size) {
+  const char* end_of_file = text + size;
+  const char* line = text;
+  // Reused for every subfunction
+  vector<size_t> subfunction_variables;
+  vector<int> values;
+  while (line < end_of_file) {
+    const char* end = static_cast<const char*>(
+        std::memchr(line, '\n', end_of_file - line));
+    if (end == nullptr) {
+      end = end_of_file;
+    }
+    const char* next = end < end_of_file ? end + 1 : end;
+    // First character of the line is used to specify its purpose
+    const char* p = skip_spaces(line, end);
     // skip blank lines and commented out lines
-    if (line.size() == 0 or line[0] == 'c') {
+    if (p == end or line[0] == 'c') {
+      line = next;
       continue;
     }
-    std::istringstream line_stream(line);
-    line_stream >> head;
+    char head = *p++;
     // If this line is the problem statement
     if (head == 'p') {
-      // read in the problem
-      string problem;
-      line_stream >> problem;
       // ensure you have a file with the right format
-      assert(problem == "MK" or problem == "NK");
-      line_stream >> length;
+      p = skip_spaces(p, end);
+      const char* problem = p;
+      while (p < end and not is_space(*p)) {
+        p++;
+      }
+      string type(problem, p);
+      if (type != "MK" and type != "NK") {
+        std::cerr << "Unsupported problem type: " << type << std::endl;
+        return false;
+      }
       // ignore everything after the length. You don't need it
+      read_index(p, end, length);
     } else if (head == 'm') {
-      // creates a new subfunction
-      subfunctions.emplace_back();
       // add the variables associated with this subfunction
+      subfunction_variables.clear();
       size_t index;
-      while (line_stream >> index) {
-        subfunctions.back().variables.push_back(index);
+      while (read_index(p, end, index)) {
+        subfunction_variables.push_back(index);
+      }
+      // The values are always on the very next line
+      const char* values_end = static_cast<const char*>(
+          std::memchr(next, '\n', end_of_file - next));
+      if (values_end == nullptr) {
+        values_end = end_of_file;
       }
-      // get the values line
-      getline(input, line);
-      std::istringstream values(line);
-      // Add the values associated with this subfunction
-      double value;
-      while (values >> value) {
-        subfunctions.back().values.push_back(value);
+      values.clear();
+      int value;
+      while (read_value(next, values_end, value)) {
+        values.push_back(value);
       }
-      // Verify that the the required number of values were read
-      size_t expected_values = 1 << subfunctions.back().variables.size();
-      assert(expected_values == subfunctions.back().values.size());
+      variables.add_row(subfunction_variables.begin(),
+                        subfunction_variables.end());
+      tables.add_row(values.begin(), values.end());
+      next = values_end < end_of_file ? values_end + 1 : values_end;
     } else {
       std::cerr << "Unexpected line header: " << head << std::endl;
     }
+    line = next;
   }
+  return true;
+}
+
+bool MKLandscape::check() const {
   // Ensures that at some point the length was set correctly
-  assert(length != 0);
-  // Ensures that all variable indices are within the specified length
-  for (const auto & subfunction : subfunctions) {
-    for (const auto & variable_index : subfunction.variables) {
-      assert(variable_index < length);
+  if (length == 0) {
+    std::cerr << "No problem line with a length was found" << std::endl;
+    return false;
+  }
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    if (variables[sub].size() > max_variables) {
+      std::cerr << "Subfunction " << sub << " has more than "
+                << max_variables << " variables" << std::endl;
+      return false;
+    }
+    // Verify that the the required number of values were read
+    size_t expected_values = size_t(1) << variables[sub].size();
+    if (tables[sub].size() != expected_values) {
+      std::cerr << "Subfunction " << sub << " has " << tables[sub].size()
+                << " values instead of " << expected_values << std::endl;
+      return false;
+    }
+    // Ensures that all variable indices are within the specified length
+    for (const auto& variable_index : variables[sub]) {
+      if (variable_index >= length) {
+        std::cerr << "Subfunction " << sub << " uses variable "
+                  << variable_index << " but the length is " << length
+                  << std::endl;
+        return false;
+      }
     }
   }
+  return true;
+}
+
+bool MKLandscape::read_cache(const string& filename, uint64_t size,
+                             int64_t modified) {
+  MappedFile file(filename);
+  CacheHeader header;
+  if (not file.valid() or file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  // Caches for older versions of the text file are silently replaced
+  if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+      or header.version != cache_version or header.source_size != size
+      or header.source_modified != modified) {
+    return false;
+  }
+  const uint64_t expected = sizeof(header)
+      + sizeof(uint32_t) * (header.subfunctions + header.variables)
+      + sizeof(int32_t) * header.values;
+  if (file.size() != expected) {
+    std::cerr << "Ignoring damaged cache " << filename << std::endl;
+    return false;
+  }
+  auto sizes = reinterpret_cast<const uint32_t*>(file.data() + sizeof(header));
+  auto indices = sizes + header.subfunctions;
+  auto values = reinterpret_cast<const int32_t*>(indices + header.variables);
+  uint64_t used_variables = 0, used_values = 0;
+  for (uint64_t sub = 0; sub < header.subfunctions; sub++) {
+    const uint64_t table_size = uint64_t(1) << std::min<size_t>(
+        sizes[sub], max_variables + 1);
+    if (sizes[sub] > max_variables
+        or used_variables + sizes[sub] > header.variables
+        or used_values + table_size > header.values) {
+      std::cerr << "Ignoring damaged cache " << filename << std::endl;
+      return false;
+    }
+    variables.add_row(indices + used_variables,
+                      indices + used_variables + sizes[sub]);
+    tables.add_row(values + used_values, values + used_values + table_size);
+    used_variables += sizes[sub];
+    used_values += table_size;
+  }
+  length = header.length;
+  return true;
+}
+
+void MKLandscape::write_cache(const string& filename, uint64_t size,
+                              int64_t modified) const {
+  CacheHeader header;
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.source_size = size;
+  header.source_modified = modified;
+  header.length = length;
+  header.subfunctions = variables.size();
+  header.variables = variables.total();
+  header.values = tables.total();
+  vector<uint32_t> sizes, indices;
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    sizes.push_back(variables[sub].size());
+    indices.insert(indices.end(), variables[sub].begin(),
+                   variables[sub].end());
+  }
+  // Written under a temporary name so other processes never see
+  // a partial cache
+  const string partial = filename + ".partial";
+  {
+    std::ofstream out(partial, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sizes.data()),
+              sizes.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(indices.data()),
+              indices.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(tables.data()),
+              tables.total() * sizeof(int32_t));
+    if (not out) {
+      std::cerr << "Unable to write cache " << filename << std::endl;
+      out.close();
+      std::remove(partial.c_str());
+      return;
+    }
+  }
+  std::rename(partial.c_str(), filename.c_str());
 }
 
 int MKLandscape::evaluate(size_t subfunction_index,
                           const vector<char>& solution) const {
   const auto& subfunction = subfunctions[subfunction_index];
+  return subfunction.values[table_index(subfunction_index, solution)];
+}
+
+size_t MKLandscape::table_index(size_t subfunction_index,
+                                const vector<char>& solution) const {
+  const auto& subfunction = subfunctions[subfunction_index];
   // Convert the solution's values to an index into the fitness table
   size_t index = 0;
   for (const auto& neighbor : subfunction.variables) {
     index = (index << 1) | solution[neighbor];
   }
-  return subfunction.values[index];
+  return index;
 }
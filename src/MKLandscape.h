@@ -18,34 +18,91 @@
 
 #ifndef MKLANDSCAPE_H_
 #define MKLANDSCAPE_H_
+#include "FlatLists.h"
 #include <iostream>
 #include <vector>
 using std::vector;
 using std::string;
 
-// Internal struct used to represent a subfunction
+// Internal struct used to represent a subfunction. Both lists are views
+// into arrays owned by the landscape.
 struct Subfunction {
-  vector<size_t> variables;
-  vector<int> values;
+  FlatLists<size_t>::Row variables;
+  FlatLists<int>::Row values;
 };
 
 // Defines an MK Landscape
 class MKLandscape {
  public:
-  // Read the landscape from a file
-  MKLandscape(string filename);
+  // Read the landscape from a file. If "use_cache" is set, a binary copy
+  // is saved next to the file (see "cache_filename") and loaded instead
+  // of the text as long as the text file hasn't changed.
+  MKLandscape(string filename, bool use_cache = false);
+  // Builds a landscape of "length_" variables from subfunctions already in
+  // memory, where row "i" of "variables_" and "tables_" is subfunction "i"
+  MKLandscape(size_t length_, FlatLists<size_t> variables_,
+              FlatLists<int> tables_);
+  // As above, with each subfunction's variables and table in its own list
+  MKLandscape(size_t length_, const vector<vector<size_t>>& variables_,
+              const vector<vector<int>>& tables_);
   ~MKLandscape() = default;
+  // Subfunctions point into the landscape's arrays, so it can't be copied
+  MKLandscape(const MKLandscape&) = delete;
+  MKLandscape& operator=(const MKLandscape&) = delete;
+  // False if the file couldn't be read or didn't describe a valid
+  // landscape. The reason has already been written to std::cerr.
+  inline bool valid() const {
+    return loaded;
+  }
   inline const vector<Subfunction>& get_subfunctions() const {
     return subfunctions;
   }
+  // Every subfunction's fitness table, stored contiguously in order
+  inline const FlatLists<int>& get_tables() const {
+    return tables;
+  }
   inline const size_t get_length() const {
     return length;
   }
   // Determines the subfunction's value given a binary "solution"
   int evaluate(size_t subfunction_index, const vector<char> & solution) const;
+  // Converts the solution's values to an index into the subfunction's
+  // fitness table. The first variable is the most significant bit.
+  size_t table_index(size_t subfunction_index,
+                     const vector<char> & solution) const;
+  // Every subfunction's variables, stored contiguously in order
+  inline const FlatLists<size_t>& get_variables() const {
+    return variables;
+  }
+  // Where the binary copy of "filename" is cached
+  static string cache_filename(const string& filename);
+  // Replaces groups of subfunctions with a single subfunction whose table
+  // is their sum. A subfunction is merged into another if its variables
+  // are a subset of the other's, or if their union has at most
+  // "max_arity" variables which all already interact with each other.
+  // "max_arity" is capped at the most variables a loaded subfunction
+  // may have.
+  // Neither changes which variables interact, so the local
+  // optima are unchanged. Returns how many subfunctions were removed.
+  size_t merge_subfunctions(size_t max_arity);
  protected:
   size_t length;
+  // Every subfunction's variables and fitness table, each stored in
+  // one contiguous array
+  FlatLists<size_t> variables;
+  FlatLists<int> tables;
   vector<Subfunction> subfunctions;
+  bool loaded;
+
+  // Fill in the arrays from the text format, returning false on errors
+  bool parse(const char* text, size_t size);
+  // Fill in the arrays from a cache file written for a text file with
+  // this size and modification time, returning false if it can't be used
+  bool read_cache(const string& filename, uint64_t size, int64_t modified);
+  void write_cache(const string& filename, uint64_t size,
+                   int64_t modified) const;
+  // Checks everything the text format requires, returning false on errors
+  bool check() const;
 };
 
 #endif /* MKLANDSCAPE_H_ */
@@ -0,0 +1,58 @@
+// Brian Goldman
+
+// Implements viewing a file through a memory map, falling back to
+// reading it when it can't be mapped.
+
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const string& filename)
+    : descriptor(open(filename.c_str(), O_RDONLY)),
+      mapped(nullptr),
+      start(nullptr),
+      bytes(0),
+      stamp(0),
+      readable(false) {
+  struct stat info;
+  if (descriptor < 0 or fstat(descriptor, &info) != 0) {
+    return;
+  }
+  bytes = info.st_size;
+  stamp = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+  if (bytes == 0) {
+    readable = true;
+    return;
+  }
+  mapped = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  if (mapped != MAP_FAILED) {
+    madvise(mapped, bytes, MADV_SEQUENTIAL);
+    start = static_cast<const char*>(mapped);
+    readable = true;
+    return;
+  }
+  // Some files can't be mapped, so read them instead
+  mapped = nullptr;
+  copy.resize(bytes);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t got = read(descriptor, &copy[done], bytes - done);
+    if (got <= 0) {
+      return;
+    }
+    done += got;
+  }
+  start = copy.data();
+  readable = true;
+}
+
+MappedFile::~MappedFile() {
+  if (mapped) {
+    munmap(mapped, bytes);
+  }
+  if (descriptor >= 0) {
+    close(descriptor);
+  }
+}
@@ -0,0 +1,45 @@
+// Brian Goldman
+
+// Read only view of an entire file, which is memory mapped when possible.
+// Used to load landscapes and the caches built from them without copying
+// the file through a stream.
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using std::string;
+
+class MappedFile {
+ public:
+  MappedFile(const string& filename);
+  ~MappedFile();
+  // The view points into the mapping, so it can't be copied
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  bool valid() const {
+    return readable;
+  }
+  const char* data() const {
+    return start;
+  }
+  size_t size() const {
+    return bytes;
+  }
+  // Modification time in nanoseconds
+  int64_t modified() const {
+    return stamp;
+  }
+ private:
+  int descriptor;
+  void* mapped;
+  string copy;
+  const char* start;
+  size_t bytes;
+  int64_t stamp;
+  bool readable;
+};
+
+#endif /* MAPPEDFILE_H_ */
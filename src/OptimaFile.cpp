@@ -0,0 +1,270 @@
+// Brian Goldman
+
+// Reading and writing of local optima files in both the
+// text and compact binary formats.
+
+#include "OptimaFile.h"
+#include "PackedBits.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+const char magic[4] = { 'M', 'K', 'L', 'O' };
+// Version 3 added tagged files, which version 2 readers would misread
+const uint32_t version = 3;
+const uint32_t untagged_version = 2;
+// Far longer than any landscape that could be enumerated, so a longer
+// header must be corrupt
+const uint64_t max_length = uint64_t(1) << 30;
+// Location of the count in the binary header
+const std::streamoff summary_offset = 28;
+
+// Writes "bytes" bytes of "value", lowest byte first
+void write_fixed(std::ostream& out, uint64_t value, size_t bytes) {
+  char buffer[8];
+  for (size_t i = 0; i < bytes; i++) {
+    buffer[i] = char(value >> (8 * i));
+  }
+  out.write(buffer, bytes);
+}
+
+bool read_fixed(std::istream& in, uint64_t& value, size_t bytes) {
+  unsigned char buffer[8];
+  if (not in.read(reinterpret_cast<char*>(buffer), bytes)) {
+    return false;
+  }
+  value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value |= uint64_t(buffer[i]) << (8 * i);
+  }
+  return true;
+}
+
+uint64_t double_bits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Uses 7 bits per byte, with the high bit set if more bytes follow
+void append_varint(string& block, uint64_t value) {
+  while (value >= 0x80) {
+    block.push_back(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  block.push_back(char(value));
+}
+}
+
+void write_text_header(std::ostream& out, const OptimaHeader& header,
+                       const char* columns) {
+  if (header.tagged) {
+    out << "# All 1-bit local optima tagged with their radius up to "
+        << header.radius;
+  } else {
+    out << "# All " << header.radius << "-bit local optima";
+  }
+  out << ". Hyper is " << (header.hyper ? "on" : "off") << ". Reorder is "
+      << (header.reorder ? "on" : "off") << "." << std::endl;
+  if (header.shards > 1) {
+    out << "# Shard " << header.shard << " of " << header.shards << std::endl;
+  }
+  if (header.strategy.size()) {
+    out << "# " << header.strategy << std::endl;
+  }
+  if (columns) {
+    out << "# " << columns << std::endl;
+  }
+}
+
+void write_text_footer(std::ostream& out, size_t count, double seconds) {
+  out << "# Count: " << count << " Seconds: " << seconds << std::endl;
+}
+
+const char* optima_columns(const OptimaHeader& header) {
+  return header.tagged ?
+      "Fitness Representation Radius" : "Fitness Representation";
+}
+
+void write_optima_header(std::ostream& out, const OptimaHeader& header) {
+  out.write(magic, sizeof(magic));
+  write_fixed(out, version, 4);
+  write_fixed(out, header.length, 4);
+  write_fixed(out, header.radius, 4);
+  write_fixed(out, header.hyper, 1);
+  write_fixed(out, header.reorder, 1);
+  write_fixed(out, header.tagged, 1);
+  write_fixed(out, 0, 1);
+  write_fixed(out, header.shard, 4);
+  write_fixed(out, header.shards, 4);
+  write_fixed(out, header.count, 8);
+  write_fixed(out, double_bits(header.seconds), 8);
+  for (const auto& bit : header.new_to_org) {
+    write_fixed(out, bit, 4);
+  }
+}
+
+void update_optima_summary(std::ostream& out, uint64_t count, double seconds) {
+  auto end = out.tellp();
+  out.seekp(summary_offset);
+  write_fixed(out, count, 8);
+  write_fixed(out, double_bits(seconds), 8);
+  out.seekp(end);
+}
+
+void append_optima_record(string& block, int fitness, int radius,
+                          const vector<uint64_t>& packed, size_t length,
+                          size_t shared) {
+  // zigzag encoding keeps small negative fitnesses small
+  uint32_t doubled = uint32_t(fitness) << 1;
+  append_varint(block, fitness < 0 ? ~doubled : doubled);
+  if (radius >= 0) {
+    append_varint(block, radius);
+  }
+  append_varint(block, shared);
+  // Positions below "remaining" are stored from the highest down, so
+  // each window of up to 64 positions is reversed before being copied
+  size_t remaining = length - shared;
+  while (remaining) {
+    const size_t width = remaining < 64 ? remaining : 64;
+    uint64_t window = packed_window(packed, remaining - width);
+    window = reverse_bits(window << (64 - width));
+    for (size_t used = 0; used < width; used += 8) {
+      block.push_back(char(window & 0xFF));
+      window >>= 8;
+    }
+    remaining -= width;
+  }
+}
+
+bool optima_to_text(std::istream& in, std::ostream& out) {
+  OptimaReader reader(in);
+  if (not reader.valid()) {
+    return false;
+  }
+  const auto& header = reader.header();
+  write_text_header(out, header, optima_columns(header));
+  string line;
+  while (reader.next()) {
+    line = std::to_string(reader.fitness());
+    line.push_back(' ');
+    for (const auto bit : reader.solution()) {
+      line.push_back('0' + bit);
+    }
+    if (header.tagged) {
+      line.push_back(' ');
+      line += std::to_string(reader.radius());
+    }
+    line.push_back('\n');
+    out << line;
+  }
+  write_text_footer(out, header.count, header.seconds);
+  return reader.valid();
+}
+
+OptimaReader::OptimaReader(std::istream& in_)
+    : in(in_),
+      good(false),
+      current_fitness(0),
+      current_radius(0) {
+  char start[4];
+  uint64_t value;
+  if (not in.read(start, sizeof(start))
+      or std::memcmp(start, magic, sizeof(magic)) != 0) {
+    std::cerr << "Not a binary local optima file" << std::endl;
+    return;
+  }
+  if (not read_fixed(in, value, 4)
+      or (value != version and value != untagged_version)) {
+    std::cerr << "Unsupported binary local optima version" << std::endl;
+    return;
+  }
+  // Every field is read before any are checked, as a failed read leaves
+  // the stream failed
+  uint64_t length, radius, hyper, reorder, tagged, unused, shard, shards,
+      seconds;
+  if (not read_fixed(in, length, 4) or not read_fixed(in, radius, 4)
+      or not read_fixed(in, hyper, 1) or not read_fixed(in, reorder, 1)
+      or not read_fixed(in, tagged, 1) or not read_fixed(in, unused, 1)
+      or not read_fixed(in, shard, 4) or not read_fixed(in, shards, 4)
+      or not read_fixed(in, head.count, 8) or not read_fixed(in, seconds, 8)) {
+    std::cerr << "Binary local optima header is truncated" << std::endl;
+    return;
+  }
+  if (length > max_length) {
+    std::cerr << "Binary local optima length is invalid" << std::endl;
+    return;
+  }
+  head.length = length;
+  head.radius = radius;
+  head.hyper = hyper;
+  head.reorder = reorder;
+  head.tagged = tagged;
+  head.shard = shard;
+  head.shards = shards;
+  std::memcpy(&head.seconds, &seconds, sizeof(seconds));
+  // Grown as positions are read, so a truncated file fails before
+  // allocating space for all of them
+  head.new_to_org.clear();
+  for (uint32_t i = 0; i < head.length; i++) {
+    if (not read_fixed(in, value, 4)) {
+      std::cerr << "Binary local optima header is truncated" << std::endl;
+      return;
+    }
+    if (value >= head.length) {
+      std::cerr << "Binary local optima ordering is invalid" << std::endl;
+      return;
+    }
+    head.new_to_org.push_back(value);
+  }
+  current.assign(head.length, 0);
+  good = bool(in);
+}
+
+bool OptimaReader::read_varint(uint64_t& value) {
+  value = 0;
+  int shift = 0;
+  int byte;
+  do {
+    byte = in.get();
+    if (byte == std::char_traits<char>::eof() or shift > 63) {
+      return false;
+    }
+    value |= uint64_t(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return true;
+}
+
+bool OptimaReader::next() {
+  uint64_t zigzag, radius = 0, shared;
+  if (not good or not read_varint(zigzag)) {
+    return false;
+  }
+  if ((head.tagged and not read_varint(radius)) or not read_varint(shared)
+      or shared > head.length) {
+    std::cerr << "Truncated binary local optima record" << std::endl;
+    good = false;
+    return false;
+  }
+  current_fitness = int(uint32_t(zigzag >> 1) ^ -uint32_t(zigzag & 1));
+  current_radius = radius;
+  const int length = head.length;
+  int byte = 0;
+  int used = 8;
+  // Only the positions below the shared prefix are stored
+  for (int i = shared; i < length; i++) {
+    if (used == 8) {
+      byte = in.get();
+      used = 0;
+    }
+    current[head.new_to_org[length - 1 - i]] = (byte >> used) & 1;
+    used++;
+  }
+  if (not in) {
+    std::cerr << "Truncated binary local optima record" << std::endl;
+    good = false;
+    return false;
+  }
+  return true;
+}
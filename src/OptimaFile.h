@@ -0,0 +1,115 @@
+// Brian Goldman
+
+// Defines the files local optima are stored in. The text format is
+// one "fitness bits" line per optimum between "#" comment lines, or
+// "fitness bits radius" if the file is tagged.
+// The binary format is a fixed header followed by one record per optimum:
+// * Header, all little endian:
+//   4 bytes "MKLO", uint32 version, uint32 length, uint32 radius,
+//   uint8 hyper, uint8 reorder, uint8 tagged, 1 unused byte, uint32 shard,
+//   uint32 shards, uint64 count, float64 seconds, then "length" uint32
+//   values giving new_to_org.
+// * Record:
+//   zigzag varint fitness, varint radius (only if tagged), varint
+//   "shared", then bit packed (lowest bit first) values for the
+//   remaining positions.
+// Record bits are stored in the remapped ordering from the highest position
+// down, so "shared" is how many leading bits are copied from the
+// previous record. Records with "shared" of 0 can be decoded on their own.
+
+#ifndef OPTIMAFILE_H_
+#define OPTIMAFILE_H_
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+using std::vector;
+using std::string;
+
+// Everything stored in a binary file besides the records
+struct OptimaHeader {
+  uint32_t length;
+  uint32_t radius;
+  bool hyper;
+  bool reorder;
+  // Tagged files hold every 1-bit local optimum, each with the largest
+  // radius up to "radius" at which it is still a local optimum
+  bool tagged;
+  // Which part of a sharded enumeration this is. "shards" is 1 when
+  // the entire search space was enumerated.
+  uint32_t shard;
+  uint32_t shards;
+  uint64_t count;
+  double seconds;
+  vector<int> new_to_org;
+  // How "hyper" and "reorder" were chosen when picked automatically.
+  // Only written to text files.
+  string strategy;
+};
+
+// Writes the comment lines which start and end a text file. If given,
+// "columns" describes the lines which follow the header.
+void write_text_header(std::ostream& out, const OptimaHeader& header,
+                       const char* columns = "Fitness Representation");
+void write_text_footer(std::ostream& out, size_t count, double seconds);
+// The columns of each local optimum's line in a text file
+const char* optima_columns(const OptimaHeader& header);
+
+// Writes the header of a binary file
+void write_optima_header(std::ostream& out, const OptimaHeader& header);
+// Seeks back to fill in the count and seconds of a binary file's header,
+// which aren't known until enumeration finishes
+void update_optima_summary(std::ostream& out, uint64_t count, double seconds);
+// Appends a record to "block". "packed" holds the solution in the remapped
+// ordering 64 bits to a word (see PackedBits.h). Records list the bits from
+// the highest position down, and the first "shared" are not stored.
+// "radius" is only stored if it isn't negative, which must match
+// whether the file is tagged.
+void append_optima_record(string& block, int fitness, int radius,
+                          const vector<uint64_t>& packed, size_t length,
+                          size_t shared);
+
+// Converts a binary file into the text format, returning false if "in"
+// was not a valid binary file
+bool optima_to_text(std::istream& in, std::ostream& out);
+
+// Streams through a binary file one local optimum at a time, only updating
+// the bits which changed between records.
+class OptimaReader {
+ public:
+  // Reads the header from "in_"
+  OptimaReader(std::istream& in_);
+  // False if "in_" did not start with a valid header
+  inline bool valid() const {
+    return good;
+  }
+  inline const OptimaHeader& header() const {
+    return head;
+  }
+  // Moves to the next local optimum, returning false once all are read
+  bool next();
+  inline int fitness() const {
+    return current_fitness;
+  }
+  // Only stored in tagged files
+  inline int radius() const {
+    return current_radius;
+  }
+  // The current local optimum using the original variable ordering
+  inline const vector<char>& solution() const {
+    return current;
+  }
+ private:
+  std::istream& in;
+  OptimaHeader head;
+  bool good;
+  int current_fitness;
+  int current_radius;
+  vector<char> current;
+  // Reads a single variable length integer
+  bool read_varint(uint64_t& value);
+};
+
+#endif /* OPTIMAFILE_H_ */
@@ -0,0 +1,239 @@
+// Brian Goldman
+
+// Implements combining shard outputs. Each file is read twice, first
+// to check that the shards fit together and then to copy out their
+// local optima, so only one file is open at a time.
+
+#include "OptimaMerge.h"
+#include "OptimaFile.h"
+#include "OptimaSummary.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+bool starts_with(const string& line, const char* prefix) {
+  return line.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// Checks that the shards are from one split with none missing or repeated
+bool complete(const vector<string>& filenames, const vector<size_t>& shard,
+              size_t shards) {
+  vector<int> seen(shards, -1);
+  for (size_t i = 0; i < filenames.size(); i++) {
+    if (shard[i] >= shards) {
+      std::cerr << filenames[i] << " is not part of a " << shards
+                << " shard enumeration" << std::endl;
+      return false;
+    }
+    if (seen[shard[i]] >= 0) {
+      std::cerr << filenames[i] << " and " << filenames[seen[shard[i]]]
+                << " are both shard " << shard[i] << std::endl;
+      return false;
+    }
+    seen[shard[i]] = i;
+  }
+  for (size_t i = 0; i < shards; i++) {
+    if (seen[i] < 0) {
+      std::cerr << "Shard " << i << " of " << shards << " is missing"
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool merge_binary(const vector<string>& filenames, std::ostream& out) {
+  OptimaHeader merged;
+  vector<size_t> shard;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    std::ifstream in(filenames[i], std::ios::binary);
+    OptimaReader reader(in);
+    if (not reader.valid()) {
+      std::cerr << "Unable to read " << filenames[i] << std::endl;
+      return false;
+    }
+    const auto& header = reader.header();
+    if (i == 0) {
+      merged = header;
+      merged.count = 0;
+      merged.seconds = 0;
+    } else if (header.length != merged.length
+        or header.radius != merged.radius or header.hyper != merged.hyper
+        or header.reorder != merged.reorder
+        or header.tagged != merged.tagged
+        or header.shards != merged.shards
+        or header.new_to_org != merged.new_to_org) {
+      std::cerr << filenames[i] << " is from a different enumeration"
+                << std::endl;
+      return false;
+    }
+    shard.push_back(header.shard);
+    merged.count += header.count;
+    merged.seconds += header.seconds;
+  }
+  if (not complete(filenames, shard, merged.shards)) {
+    return false;
+  }
+  merged.shard = 0;
+  merged.shards = 1;
+  write_optima_header(out, merged);
+  // The first record of every shard doesn't share anything, so records
+  // can be copied without decoding them
+  for (const auto& filename : filenames) {
+    std::ifstream in(filename, std::ios::binary);
+    OptimaReader reader(in);
+    if (in.peek() != std::char_traits<char>::eof()) {
+      out << in.rdbuf();
+    }
+  }
+  return bool(out);
+}
+
+// The comment lines at the start of a text file
+struct TextHeader {
+  string description;
+  size_t shard;
+  size_t shards;
+  // Empty for count only files
+  string columns;
+};
+
+// Reads the header lines of a text file. As count only files have no
+// columns line, "next" is set to the first line after the header.
+bool read_text_header(std::istream& in, TextHeader& header, string& next) {
+  header.shard = 0;
+  header.shards = 1;
+  header.columns.clear();
+  if (not getline(in, header.description)
+      or not starts_with(header.description, "# All ")) {
+    return false;
+  }
+  if (not getline(in, next)) {
+    return false;
+  }
+  if (starts_with(next, "# Shard ")) {
+    std::istringstream parse(next.substr(8));
+    string of;
+    parse >> header.shard >> of >> header.shards;
+    if (not parse or of != "of" or not getline(in, next)) {
+      return false;
+    }
+  }
+  if (not starts_with(next, "# Count: ")) {
+    header.columns = next;
+    next.clear();
+  }
+  return true;
+}
+
+bool merge_text(const vector<string>& filenames, std::ostream& out) {
+  TextHeader merged, header;
+  vector<size_t> shard;
+  string line;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    std::ifstream in(filenames[i]);
+    if (not read_text_header(in, header, line)) {
+      std::cerr << "Unable to read " << filenames[i] << std::endl;
+      return false;
+    }
+    if (i == 0) {
+      merged = header;
+    } else if (header.description != merged.description
+        or header.columns != merged.columns
+        or header.shards != merged.shards) {
+      std::cerr << filenames[i] << " is from a different enumeration"
+                << std::endl;
+      return false;
+    }
+    shard.push_back(header.shard);
+  }
+  if (not complete(filenames, shard, merged.shards)) {
+    return false;
+  }
+  out << merged.description << std::endl;
+  if (merged.columns.size()) {
+    out << merged.columns << std::endl;
+  }
+
+  const bool histogram = merged.columns == "# Histogram Fitness Count";
+  std::map<int, size_t> counts;
+  vector<HistogramSink::Optimum> best;
+  size_t best_k = 0;
+  size_t count = 0;
+  double seconds = 0;
+  for (const auto& filename : filenames) {
+    std::ifstream in(filename);
+    read_text_header(in, header, line);
+    bool in_best = false;
+    bool footer = false;
+    // The header may have already read the first line
+    bool have_line = line.size() > 0;
+    while (have_line or getline(in, line)) {
+      have_line = false;
+      if (starts_with(line, "# Count: ")) {
+        std::istringstream parse(line.substr(9));
+        size_t shard_count;
+        string label;
+        double shard_seconds;
+        parse >> shard_count >> label >> shard_seconds;
+        count += shard_count;
+        seconds += shard_seconds;
+        footer = true;
+      } else if (line.empty() or line[0] != '#') {
+        out << line << '\n';
+      } else if (histogram and starts_with(line, "# Best ")) {
+        size_t k;
+        std::istringstream(line.substr(7)) >> k;
+        best_k = std::max(best_k, k);
+        in_best = true;
+      } else if (histogram and not starts_with(line, "# Min: ")) {
+        std::istringstream parse(line.substr(2));
+        int fitness;
+        parse >> fitness;
+        if (in_best) {
+          string bits;
+          parse >> bits;
+          vector<char> solution(bits.size());
+          for (size_t b = 0; b < bits.size(); b++) {
+            solution[b] = bits[b] == '1';
+          }
+          best.emplace_back(fitness, solution);
+        } else {
+          size_t fitness_count;
+          parse >> fitness_count;
+          counts[fitness] += fitness_count;
+        }
+      }
+    }
+    if (not footer) {
+      std::cerr << filename << " is incomplete" << std::endl;
+      return false;
+    }
+  }
+  if (histogram) {
+    // The sink writes the combined histogram lines and footer
+    HistogramSink sink(out, best_k);
+    sink.merge(counts, best);
+    sink.finish(count, seconds);
+  } else {
+    write_text_footer(out, count, seconds);
+  }
+  return bool(out);
+}
+}
+
+bool merge_optima(const vector<string>& filenames, std::ostream& out) {
+  if (filenames.empty()) {
+    return false;
+  }
+  // Binary files are recognized by their first few bytes
+  char start[4] = { 0 };
+  std::ifstream(filenames[0], std::ios::binary).read(start, sizeof(start));
+  if (std::memcmp(start, "MKLO", sizeof(start)) == 0) {
+    return merge_binary(filenames, out);
+  }
+  return merge_text(filenames, out);
+}
@@ -0,0 +1,23 @@
+// Brian Goldman
+
+// Combines the outputs of a sharded enumeration (see "--shard") into a
+// single file, as if the entire search space was enumerated at once.
+// Works with text, binary, histogram and count only outputs, as long as
+// every shard used the same mode.
+
+#ifndef OPTIMAMERGE_H_
+#define OPTIMAMERGE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+using std::vector;
+using std::string;
+
+// Writes the combination of every shard in "filenames" to "out". The
+// total count is the sum of the shards' counts, and the seconds are
+// the sum of their seconds. Returns false if shards are missing,
+// repeated, or come from different enumerations.
+bool merge_optima(const vector<string>& filenames, std::ostream& out);
+
+#endif /* OPTIMAMERGE_H_ */
@@ -0,0 +1,59 @@
+// Brian Goldman
+
+// Interface for anything which receives the local optima found
+// by an Enumeration, such as writing them to a file or
+// only keeping summary statistics.
+
+#ifndef OPTIMASINK_H_
+#define OPTIMASINK_H_
+
+#include "OptimaFile.h"
+#include <memory>
+
+class OptimaSink {
+ public:
+  // Each walk gathers its optima in its own Block, which hands them
+  // to the sink in bulk. Blocks are only used by a single thread.
+  class Block {
+   public:
+    virtual ~Block() = default;
+    // Called for every local optimum the walk finds. "packed" is the
+    // same solution in the remapped ordering, 64 positions per word
+    // (see PackedBits.h). "radius" is the largest radius at which it is
+    // a local optimum, which is only known if the header is tagged.
+    virtual void add(int fitness, const vector<char>& solution,
+                     const vector<uint64_t>& packed, int radius) = 0;
+    // Hands everything gathered so far to the sink. Safe to call from
+    // multiple threads.
+    virtual void submit() = 0;
+  };
+  virtual ~OptimaSink() = default;
+  // Called once before any optima are found. "header.count" and
+  // "header.seconds" are not yet known.
+  virtual void start(const OptimaHeader& header) = 0;
+  virtual std::unique_ptr<Block> make_block() = 0;
+  // Called once after all blocks have been submitted
+  virtual void finish(size_t count, double seconds) = 0;
+  // Once true, the enumeration stops as soon as it can and then calls
+  // "finish" with the optima found so far. Safe to call from multiple
+  // threads.
+  virtual bool stopped() const {
+    return false;
+  }
+
+  // Checkpoint support, which is optional. Once all blocks are submitted,
+  // "save" makes everything durable, adds anything else the sink needs
+  // to continue to "state", and returns how many bytes of output are
+  // complete.
+  virtual uint64_t save(string& state) {
+    return 0;
+  }
+  // Called instead of "start" when continuing from a checkpoint, after
+  // the output was cut back to the saved length. Returns false if this
+  // sink does not support checkpoints.
+  virtual bool resume(const OptimaHeader& header, const string& state) {
+    return false;
+  }
+};
+
+#endif /* OPTIMASINK_H_ */
@@ -0,0 +1,248 @@
+// Brian Goldman
+
+// Implements the summary sinks, which gather statistics about
+// local optima in memory and write them as "#" comment lines.
+
+#include "OptimaSummary.h"
+#include "PackedBits.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+// Count sinks have nothing to do for each optimum
+class EmptyBlock : public OptimaSink::Block {
+ public:
+  void add(int, const vector<char>&, const vector<uint64_t>&, int) override {
+  }
+  void submit() override {
+  }
+};
+}
+
+CountSink::CountSink(std::ostream& out_)
+    : out(out_) {
+}
+
+void CountSink::start(const OptimaHeader& header) {
+  write_text_header(out, header, nullptr);
+}
+
+std::unique_ptr<OptimaSink::Block> CountSink::make_block() {
+  return std::unique_ptr<Block>(new EmptyBlock());
+}
+
+void CountSink::finish(size_t count, double seconds) {
+  write_text_footer(out, count, seconds);
+}
+
+uint64_t CountSink::save(string& state) {
+  // The count itself is stored by the checkpoint
+  out.flush();
+  return out.tellp();
+}
+
+bool CountSink::resume(const OptimaHeader& header, const string& state) {
+  out.seekp(0, std::ios::end);
+  return true;
+}
+
+bool HistogramSink::better(const Optimum& a, const Optimum& b) {
+  if (a.first != b.first) {
+    return a.first > b.first;
+  }
+  return a.second < b.second;
+}
+
+void keep_best(vector<HistogramSink::Optimum>& best, size_t best_k,
+               int fitness, const vector<char>& solution) {
+  if (best.size() < best_k) {
+    best.emplace_back(fitness, solution);
+    std::push_heap(best.begin(), best.end(), HistogramSink::better);
+  } else if (best_k > 0 and fitness >= best.front().first) {
+    HistogramSink::Optimum optimum(fitness, solution);
+    if (HistogramSink::better(optimum, best.front())) {
+      // Replace the worst of the kept optima
+      std::pop_heap(best.begin(), best.end(), HistogramSink::better);
+      best.back().swap(optimum);
+      std::push_heap(best.begin(), best.end(), HistogramSink::better);
+    }
+  }
+}
+
+// Gathers a walk's histogram and best optima without any locking
+class HistogramSink::HistogramBlock : public OptimaSink::Block {
+ public:
+  HistogramBlock(HistogramSink& sink_)
+      : sink(sink_) {
+  }
+  ~HistogramBlock() {
+    submit();
+  }
+  void add(int fitness, const vector<char>& solution,
+           const vector<uint64_t>&, int) override {
+    histogram[fitness]++;
+    keep_best(best, sink.best_k, fitness, solution);
+  }
+  void submit() override {
+    sink.merge(histogram, best);
+    histogram.clear();
+    best.clear();
+  }
+ private:
+  HistogramSink& sink;
+  std::map<int, size_t> histogram;
+  vector<Optimum> best;
+};
+
+HistogramSink::HistogramSink(std::ostream& out_, size_t best_k_)
+    : out(out_),
+      best_k(best_k_) {
+}
+
+void HistogramSink::start(const OptimaHeader& header) {
+  write_text_header(out, header, "Histogram Fitness Count");
+}
+
+std::unique_ptr<OptimaSink::Block> HistogramSink::make_block() {
+  return std::unique_ptr<Block>(new HistogramBlock(*this));
+}
+
+void HistogramSink::merge(const std::map<int, size_t>& block_histogram,
+                          vector<Optimum>& block_best) {
+  std::lock_guard<std::mutex> lock(guard);
+  for (const auto& fitness_count : block_histogram) {
+    histogram[fitness_count.first] += fitness_count.second;
+  }
+  for (const auto& optimum : block_best) {
+    keep_best(best, best_k, optimum.first, optimum.second);
+  }
+}
+
+uint64_t HistogramSink::save(string& state) {
+  std::ostringstream stored;
+  stored << histogram.size() << " ";
+  for (const auto& fitness_count : histogram) {
+    stored << fitness_count.first << " " << fitness_count.second << " ";
+  }
+  stored << best.size() << " ";
+  for (const auto& optimum : best) {
+    stored << optimum.first << " ";
+    for (const auto bit : optimum.second) {
+      stored << char('0' + bit);
+    }
+    stored << " ";
+  }
+  state = stored.str();
+  out.flush();
+  return out.tellp();
+}
+
+bool HistogramSink::resume(const OptimaHeader& header, const string& state) {
+  std::istringstream stored(state);
+  size_t entries;
+  stored >> entries;
+  for (size_t i = 0; i < entries; i++) {
+    int fitness;
+    stored >> fitness;
+    stored >> histogram[fitness];
+  }
+  stored >> entries;
+  string bits;
+  for (size_t i = 0; i < entries; i++) {
+    int fitness;
+    stored >> fitness >> bits;
+    vector<char> solution(bits.size());
+    for (size_t b = 0; b < bits.size(); b++) {
+      solution[b] = bits[b] == '1';
+    }
+    keep_best(best, best_k, fitness, solution);
+  }
+  out.seekp(0, std::ios::end);
+  return bool(stored);
+}
+
+void HistogramSink::finish(size_t count, double seconds) {
+  for (const auto& fitness_count : histogram) {
+    out << "# " << fitness_count.first << " " << fitness_count.second
+        << std::endl;
+  }
+  if (best_k) {
+    out << "# Best " << best_k << " Fitness Representation" << std::endl;
+    std::sort(best.begin(), best.end(), better);
+    for (const auto& optimum : best) {
+      out << "# " << optimum.first << " ";
+      for (const auto bit : optimum.second) {
+        out << char('0' + bit);
+      }
+      out << std::endl;
+    }
+  }
+  if (histogram.size()) {
+    out << "# Min: " << histogram.begin()->first << " Max: "
+        << histogram.rbegin()->first << std::endl;
+  }
+  write_text_footer(out, count, seconds);
+}
+
+// Keeps a walk's best optima without any locking
+class TopSink::TopBlock : public OptimaSink::Block {
+ public:
+  TopBlock(TopSink& sink_)
+      : sink(sink_) {
+  }
+  ~TopBlock() {
+    submit();
+  }
+  void add(int fitness, const vector<char>& solution,
+           const vector<uint64_t>&, int) override {
+    keep_best(best, sink.best_k, fitness, solution);
+  }
+  void submit() override {
+    sink.merge(best);
+    best.clear();
+  }
+ private:
+  TopSink& sink;
+  vector<HistogramSink::Optimum> best;
+};
+
+TopSink::TopSink(OptimaSink& inner_, size_t best_k_)
+    : inner(inner_),
+      best_k(best_k_) {
+}
+
+void TopSink::start(const OptimaHeader& header) {
+  new_to_org = header.new_to_org;
+  radius = header.radius;
+  inner.start(header);
+}
+
+std::unique_ptr<OptimaSink::Block> TopSink::make_block() {
+  return std::unique_ptr<Block>(new TopBlock(*this));
+}
+
+void TopSink::merge(vector<HistogramSink::Optimum>& block_best) {
+  std::lock_guard<std::mutex> lock(guard);
+  for (const auto& optimum : block_best) {
+    keep_best(best, best_k, optimum.first, optimum.second);
+  }
+}
+
+void TopSink::finish(size_t count, double seconds) {
+  std::sort(best.begin(), best.end(), HistogramSink::better);
+  {
+    auto block = inner.make_block();
+    vector<uint64_t> packed;
+    for (const auto& optimum : best) {
+      packed.assign(packed_words(new_to_org.size()), 0);
+      for (size_t i = 0; i < new_to_org.size(); i++) {
+        if (optimum.second[new_to_org[i]]) {
+          toggle_packed_bit(packed, i);
+        }
+      }
+      block->add(optimum.first, optimum.second, packed, radius);
+    }
+    block->submit();
+  }
+  inner.finish(best.size(), seconds);
+}
@@ -0,0 +1,88 @@
+// Brian Goldman
+
+// Sinks which only keep summary information about the local optima
+// instead of writing each one out. Useful when only the number or
+// quality of local optima is needed, as nothing is formatted per optimum.
+
+#ifndef OPTIMASUMMARY_H_
+#define OPTIMASUMMARY_H_
+
+#include "OptimaSink.h"
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <utility>
+
+// Only reports how many local optima were found
+class CountSink : public OptimaSink {
+ public:
+  CountSink(std::ostream& out_);
+  void start(const OptimaHeader& header) override;
+  std::unique_ptr<Block> make_block() override;
+  void finish(size_t count, double seconds) override;
+  uint64_t save(string& state) override;
+  bool resume(const OptimaHeader& header, const string& state) override;
+ private:
+  std::ostream& out;
+};
+
+// Reports how many local optima have each fitness, along with the
+// "best_k_" local optima with the highest fitness.
+class HistogramSink : public OptimaSink {
+ public:
+  HistogramSink(std::ostream& out_, size_t best_k_);
+  void start(const OptimaHeader& header) override;
+  std::unique_ptr<Block> make_block() override;
+  void finish(size_t count, double seconds) override;
+  // Stores the histogram and best optima as text in "state"
+  uint64_t save(string& state) override;
+  bool resume(const OptimaHeader& header, const string& state) override;
+  // Pairs of fitness and solution
+  typedef std::pair<int, vector<char>> Optimum;
+  // Orders optima from best to worst, breaking fitness ties using the
+  // solution so the kept optima don't depend on thread scheduling.
+  static bool better(const Optimum& a, const Optimum& b);
+  // Combines a block's or shard's information into the totals
+  void merge(const std::map<int, size_t>& block_histogram,
+             vector<Optimum>& block_best);
+ private:
+  class HistogramBlock;
+  std::ostream& out;
+  size_t best_k;
+  std::mutex guard;
+  // Number of local optima found with each fitness
+  std::map<int, size_t> histogram;
+  // Heap of the best local optima found, worst at the front
+  vector<Optimum> best;
+};
+
+// Only keeps the "best_k_" local optima with the highest fitness, which
+// are handed to "inner" once the enumeration finishes. Meant to be used
+// with Enumeration::set_threshold, so walks skip optima which can't be
+// among the best. Does not keep the radius of tagged optima.
+class TopSink : public OptimaSink {
+ public:
+  TopSink(OptimaSink& inner_, size_t best_k_);
+  void start(const OptimaHeader& header) override;
+  std::unique_ptr<Block> make_block() override;
+  void finish(size_t count, double seconds) override;
+  // Combines a block's best optima into the totals
+  void merge(vector<HistogramSink::Optimum>& block_best);
+ private:
+  class TopBlock;
+  OptimaSink& inner;
+  size_t best_k;
+  std::mutex guard;
+  // Used to build the remapped solution the inner sink expects
+  vector<int> new_to_org;
+  int radius;
+  // Heap of the best local optima found, worst at the front
+  vector<HistogramSink::Optimum> best;
+};
+
+// Adds "optimum" to "best" if it is one of the "best_k" best seen so far.
+// "best" is maintained as a heap with the worst optimum at the front.
+void keep_best(vector<HistogramSink::Optimum>& best, size_t best_k,
+               int fitness, const vector<char>& solution);
+
+#endif /* OPTIMASUMMARY_H_ */
@@ -0,0 +1,227 @@
+// Brian Goldman
+
+// Implements double buffered writing of local optima, where the
+// enumeration fills one buffer while a background thread writes the other.
+
+#include "OptimaWriter.h"
+#include "OptimaFile.h"
+#include "PackedBits.h"
+#include <cstdio>
+
+const size_t OptimaWriter::block_size;
+
+OptimaWriter::OptimaWriter(std::ostream& out_, OptimaFormat format_,
+                           size_t buffer_size_)
+    : out(out_),
+      format(format_),
+      tagged(false),
+      buffer_size(buffer_size_),
+      finished(false) {
+}
+
+OptimaWriter::~OptimaWriter() {
+  stop();
+}
+
+void OptimaWriter::start(const OptimaHeader& header) {
+  tagged = header.tagged;
+  if (format == OptimaFormat::text) {
+    write_text_header(out, header, optima_columns(header));
+  } else {
+    write_optima_header(out, header);
+  }
+  launch();
+}
+
+bool OptimaWriter::resume(const OptimaHeader& header, const string& state) {
+  tagged = header.tagged;
+  // Everything before the end of the stream was already written
+  out.seekp(0, std::ios::end);
+  launch();
+  return true;
+}
+
+uint64_t OptimaWriter::save(string& state) {
+  std::unique_lock<std::mutex> lock(guard);
+  if (filling.size()) {
+    swap_buffers(lock);
+  }
+  drained.wait(lock, [this]() {return draining.empty();});
+  out.flush();
+  return out.tellp();
+}
+
+void OptimaWriter::launch() {
+  // Both buffers are reused for the entire run
+  filling.reserve(buffer_size + block_size);
+  draining.reserve(buffer_size + block_size);
+  finished = false;
+  writer = std::thread(&OptimaWriter::drain, this);
+}
+
+void OptimaWriter::finish(size_t count, double seconds) {
+  stop();
+  if (format == OptimaFormat::text) {
+    write_text_footer(out, count, seconds);
+  } else {
+    update_optima_summary(out, count, seconds);
+  }
+  out.flush();
+}
+
+class OptimaWriter::FormattedBlock : public OptimaSink::Block {
+ public:
+  FormattedBlock(OptimaWriter& writer_)
+      : writer(writer_) {
+  }
+  ~FormattedBlock() {
+    submit();
+  }
+  void add(int fitness, const vector<char>& solution,
+           const vector<uint64_t>& packed, int radius) override;
+  // Encodes a binary record onto the end of "bytes". "radius" is only
+  // stored if it isn't negative.
+  void append_binary(int fitness, int radius, const vector<uint64_t>& packed,
+                     size_t length);
+  void submit() override {
+    writer.submit(bytes);
+  }
+ private:
+  OptimaWriter& writer;
+  string bytes;
+  // Remapped bits of the last record
+  vector<uint64_t> previous;
+};
+
+std::unique_ptr<OptimaSink::Block> OptimaWriter::make_block() {
+  return std::unique_ptr<OptimaSink::Block>(new FormattedBlock(*this));
+}
+
+namespace {
+// Appends "fitness bits\n" to "bytes", or "fitness bits radius\n" if
+// "radius" isn't negative
+void append_text(string& bytes, int fitness, const vector<char>& solution,
+                 int radius) {
+  // Lookup for converting a bit into its character
+  static const char digits[] = "01";
+  // Write the fitness backwards into a small buffer
+  char number[16];
+  char* end = number + sizeof(number);
+  char* start = end;
+  unsigned magnitude = fitness < 0 ? -unsigned(fitness) : fitness;
+  do {
+    *--start = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+  if (fitness < 0) {
+    *--start = '-';
+  }
+  // Tagged files end each line with the radius
+  char tag[16];
+  int tag_length = 0;
+  if (radius >= 0) {
+    tag_length = snprintf(tag, sizeof(tag), " %d", radius);
+  }
+  size_t position = bytes.size();
+  bytes.resize(position + (end - start) + solution.size() + tag_length + 2);
+  char* text = &bytes[position];
+  for (const char* digit = start; digit != end; digit++) {
+    *text++ = *digit;
+  }
+  *text++ = ' ';
+  for (const auto bit : solution) {
+    *text++ = digits[int(bit)];
+  }
+  for (int i = 0; i < tag_length; i++) {
+    *text++ = tag[i];
+  }
+  *text = '\n';
+}
+}
+
+void OptimaWriter::FormattedBlock::add(int fitness,
+                                       const vector<char>& solution,
+                                       const vector<uint64_t>& packed,
+                                       int radius) {
+  if (not writer.tagged) {
+    radius = -1;
+  }
+  if (writer.format == OptimaFormat::text) {
+    append_text(bytes, fitness, solution, radius);
+  } else {
+    append_binary(fitness, radius, packed, solution.size());
+  }
+  if (bytes.size() >= block_size) {
+    submit();
+  }
+}
+
+void OptimaWriter::FormattedBlock::append_binary(
+    int fitness, int radius, const vector<uint64_t>& packed, size_t length) {
+  // The first record in a block doesn't share anything. Otherwise the
+  // shared bits end just above the highest position that changed.
+  size_t shared = 0;
+  if (bytes.size()) {
+    shared = length;
+    for (size_t w = packed.size(); w > 0; w--) {
+      const uint64_t changed = packed[w - 1] ^ previous[w - 1];
+      if (changed) {
+        shared = length - 1 - (((w - 1) << 6) + highest_one(changed));
+        break;
+      }
+    }
+  }
+  append_optima_record(bytes, fitness, radius, packed, length, shared);
+  previous = packed;
+}
+
+void OptimaWriter::submit(string& bytes) {
+  if (bytes.empty()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(guard);
+  filling.append(bytes);
+  bytes.clear();
+  if (filling.size() >= buffer_size) {
+    swap_buffers(lock);
+  }
+}
+
+void OptimaWriter::swap_buffers(std::unique_lock<std::mutex>& lock) {
+  // Only blocks if the disk has fallen an entire buffer behind
+  drained.wait(lock, [this]() {return draining.empty();});
+  filling.swap(draining);
+  ready.notify_one();
+}
+
+void OptimaWriter::stop() {
+  std::unique_lock<std::mutex> lock(guard);
+  if (not writer.joinable()) {
+    return;
+  }
+  if (filling.size()) {
+    swap_buffers(lock);
+  }
+  finished = true;
+  ready.notify_one();
+  lock.unlock();
+  writer.join();
+}
+
+void OptimaWriter::drain() {
+  std::unique_lock<std::mutex> lock(guard);
+  while (true) {
+    ready.wait(lock, [this]() {return draining.size() or finished;});
+    if (draining.empty()) {
+      // Only reachable once finished with nothing left to write
+      return;
+    }
+    // Other threads only touch "draining" once it is empty, so
+    // the lock isn't needed while writing it
+    lock.unlock();
+    out.write(draining.data(), draining.size());
+    lock.lock();
+    draining.clear();
+    drained.notify_all();
+  }
+}
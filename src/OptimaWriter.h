@@ -0,0 +1,75 @@
+// Brian Goldman
+
+// Writes local optima to an output stream without making the
+// enumeration wait on the disk. Optima are formatted into large
+// blocks of text or binary records (see OptimaFile.h), which a
+// background thread writes while the next block is being filled.
+
+#ifndef OPTIMAWRITER_H_
+#define OPTIMAWRITER_H_
+
+#include "OptimaSink.h"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using std::vector;
+using std::string;
+
+// How each local optimum is stored
+enum class OptimaFormat {
+  text,
+  binary
+};
+
+class OptimaWriter : public OptimaSink {
+ public:
+  // Blocks hand over their output once it reaches this size
+  static const size_t block_size = 1 << 16;
+  OptimaWriter(std::ostream& out_, OptimaFormat format_,
+               size_t buffer_size_ = 1 << 22);
+  ~OptimaWriter();
+  // Writes the file's header and starts the background thread
+  void start(const OptimaHeader& header) override;
+  std::unique_ptr<OptimaSink::Block> make_block() override;
+  // Writes everything submitted so far, stops the background thread,
+  // and then completes the file.
+  void finish(size_t count, double seconds) override;
+  // Waits for the background thread to write everything submitted
+  uint64_t save(string& state) override;
+  // Continues writing from the current end of the stream
+  bool resume(const OptimaHeader& header, const string& state) override;
+ private:
+  // Formats optima into text or binary records. Binary records are
+  // encoded against the previous record in the same block, so each
+  // block can be decoded on its own.
+  class FormattedBlock;
+  std::ostream& out;
+  OptimaFormat format;
+  // If each optimum's radius is written
+  bool tagged;
+  // How much output is gathered before it is handed to the background thread
+  size_t buffer_size;
+  // Output is added to "filling" while "draining" is being written to "out"
+  string filling, draining;
+  bool finished;
+  std::mutex guard;
+  // Signals that "draining" has output to write, or that it was emptied
+  std::condition_variable ready, drained;
+  std::thread writer;
+
+  // Queues all of "bytes" for writing and empties it.
+  void submit(string& bytes);
+  // Background loop which writes out each "draining" buffer
+  void drain();
+  // Writes all queued output and joins the background thread
+  void stop();
+  // Starts the background thread
+  void launch();
+  // Moves "filling" into "draining" once it is free. Requires "guard".
+  void swap_buffers(std::unique_lock<std::mutex>& lock);
+};
+
+#endif /* OPTIMAWRITER_H_ */
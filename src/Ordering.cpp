@@ -0,0 +1,241 @@
+// Brian Goldman
+
+// Implements the variable ordering heuristics used to improve
+// hyperplane elimination.
+
+#include "Ordering.h"
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <set>
+#include <utility>
+
+const vector<Ordering>& all_orderings() {
+  static const vector<Ordering> orderings = { Ordering::none, Ordering::moves,
+      Ordering::min_degree, Ordering::min_fill, Ordering::rcm };
+  return orderings;
+}
+
+const char* ordering_name(Ordering ordering) {
+  switch (ordering) {
+    case Ordering::none:
+      return "none";
+    case Ordering::moves:
+      return "moves";
+    case Ordering::min_degree:
+      return "min-degree";
+    case Ordering::min_fill:
+      return "min-fill";
+    case Ordering::rcm:
+      return "rcm";
+  }
+  return "unknown";
+}
+
+bool parse_ordering(const string& name, Ordering& ordering) {
+  for (const auto& option : all_orderings()) {
+    if (name == ordering_name(option)) {
+      ordering = option;
+      return true;
+    }
+  }
+  return false;
+}
+
+vector<int> order_by_moves(size_t length,
+                           const FlatLists<size_t>& dependencies) {
+  const size_t moves = dependencies.size();
+  const size_t none = moves;
+  // Moves are stored in buckets based on how many of their dependencies
+  // are still waiting for a position. Each bucket is a doubly linked list
+  // so moves can change buckets in constant time.
+  vector<size_t> waiting(moves), head(length + 1, none), next(moves, none),
+      previous(moves, none);
+  auto insert = [&](size_t move) {
+    size_t& first = head[waiting[move]];
+    next[move] = first;
+    previous[move] = none;
+    if (first != none) {
+      previous[first] = move;
+    }
+    first = move;
+  };
+  auto erase = [&](size_t move) {
+    if (previous[move] != none) {
+      next[previous[move]] = next[move];
+    } else {
+      head[waiting[move]] = next[move];
+    }
+    if (next[move] != none) {
+      previous[next[move]] = previous[move];
+    }
+  };
+  // Lookup for finding all moves which depend on a bit
+  FlatLists<size_t> bit_to_move(length);
+  for (size_t move = 0; move < moves; move++) {
+    for (const auto& bit : dependencies[move]) {
+      bit_to_move.count(bit);
+    }
+  }
+  bit_to_move.allocate();
+  for (size_t move = 0; move < moves; move++) {
+    for (const auto& bit : dependencies[move]) {
+      bit_to_move.add(bit, move);
+    }
+    waiting[move] = dependencies[move].size();
+    insert(move);
+  }
+
+  vector<int> new_to_org(length, -1);
+  vector<char> placed(length, false);
+  int highest_available = length - 1;
+  // No bucket below "lowest" has any moves in it. Moves with nothing
+  // left waiting are never chosen, so bucket 0 is not used.
+  size_t lowest = 1;
+  while (highest_available >= 0) {
+    // Find the move with the least remaining dependencies
+    while (lowest <= length and head[lowest] == none) {
+      lowest++;
+    }
+    if (lowest > length) {
+      break;
+    }
+    size_t move = head[lowest];
+    // Assign all of its bits as high as possible
+    for (const auto& bit : dependencies[move]) {
+      if (placed[bit]) {
+        continue;
+      }
+      placed[bit] = true;
+      new_to_org[highest_available--] = bit;
+      // Update how many dependencies all other moves have
+      for (const auto& affected : bit_to_move[bit]) {
+        erase(affected);
+        waiting[affected]--;
+        if (waiting[affected]) {
+          insert(affected);
+          lowest = std::min(lowest, waiting[affected]);
+        }
+      }
+    }
+  }
+  // Bits which no move depends on go at the bottom
+  for (size_t bit = 0; bit < length; bit++) {
+    if (not placed[bit]) {
+      new_to_org[highest_available--] = bit;
+    }
+  }
+  return new_to_org;
+}
+
+vector<int> order_by_elimination(const vector<unordered_set<size_t>>& graph,
+                                 bool min_fill) {
+  const size_t length = graph.size();
+  // Edges between variables not yet eliminated, including fill edges
+  auto remaining = graph;
+  auto score = [&](size_t v) {
+    if (not min_fill) {
+      return remaining[v].size();
+    }
+    // Count the pairs of neighbors which are not yet connected
+    size_t missing = 0;
+    for (const auto& a : remaining[v]) {
+      for (const auto& b : remaining[v]) {
+        if (a < b and remaining[a].count(b) == 0) {
+          missing++;
+        }
+      }
+    }
+    return missing;
+  };
+  // Ties are broken by variable index so the ordering is repeatable
+  vector<size_t> scores(length);
+  std::set<std::pair<size_t, size_t>> queue;
+  for (size_t v = 0; v < length; v++) {
+    scores[v] = score(v);
+    queue.emplace(scores[v], v);
+  }
+  vector<int> new_to_org;
+  vector<size_t> neighbors, affected;
+  vector<char> marked(length, false);
+  while (queue.size()) {
+    size_t v = queue.begin()->second;
+    queue.erase(queue.begin());
+    new_to_org.push_back(v);
+    // Eliminating "v" connects all of its neighbors to each other
+    neighbors.assign(remaining[v].begin(), remaining[v].end());
+    for (const auto& a : neighbors) {
+      remaining[a].erase(v);
+      for (const auto& b : neighbors) {
+        if (a != b) {
+          remaining[a].insert(b);
+        }
+      }
+    }
+    remaining[v].clear();
+    // Only the neighbors' scores, or for min fill also their neighbors'
+    // scores, can have changed
+    affected = neighbors;
+    if (min_fill) {
+      for (const auto& a : neighbors) {
+        affected.insert(affected.end(), remaining[a].begin(),
+                        remaining[a].end());
+      }
+    }
+    for (const auto& u : affected) {
+      if (marked[u]) {
+        continue;
+      }
+      marked[u] = true;
+      queue.erase(std::make_pair(scores[u], u));
+      scores[u] = score(u);
+      queue.emplace(scores[u], u);
+    }
+    for (const auto& u : affected) {
+      marked[u] = false;
+    }
+  }
+  return new_to_org;
+}
+
+vector<int> order_by_rcm(const vector<unordered_set<size_t>>& graph) {
+  const size_t length = graph.size();
+  auto fewer_neighbors = [&graph](size_t a, size_t b) {
+    if (graph[a].size() != graph[b].size()) {
+      return graph[a].size() < graph[b].size();
+    }
+    return a < b;
+  };
+  // Each connected component starts from its lowest degree variable
+  vector<size_t> starts(length);
+  std::iota(starts.begin(), starts.end(), 0);
+  std::sort(starts.begin(), starts.end(), fewer_neighbors);
+  vector<char> visited(length, false);
+  vector<int> order;
+  std::deque<size_t> frontier;
+  vector<size_t> neighbors;
+  for (const auto& start : starts) {
+    if (visited[start]) {
+      continue;
+    }
+    visited[start] = true;
+    frontier.push_back(start);
+    // Breadth first, visiting lower degree neighbors first
+    while (frontier.size()) {
+      size_t v = frontier.front();
+      frontier.pop_front();
+      order.push_back(v);
+      neighbors.clear();
+      for (const auto& neighbor : graph[v]) {
+        if (not visited[neighbor]) {
+          visited[neighbor] = true;
+          neighbors.push_back(neighbor);
+        }
+      }
+      std::sort(neighbors.begin(), neighbors.end(), fewer_neighbors);
+      frontier.insert(frontier.end(), neighbors.begin(), neighbors.end());
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
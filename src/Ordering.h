@@ -0,0 +1,50 @@
+// Brian Goldman
+
+// Heuristics for choosing which position each variable gets during
+// enumeration. Hyperplane elimination can only skip the solutions below
+// a move when all of the bits it depends on are at higher positions,
+// so good orderings put the bits each move depends on close together.
+// Every heuristic returns "new_to_org", the original index of the
+// variable at each position.
+
+#ifndef ORDERING_H_
+#define ORDERING_H_
+
+#include "GraphUtilities.h"
+#include <string>
+using std::string;
+
+enum class Ordering {
+  // Keep the original variable order
+  none,
+  // Repeatedly give the highest positions to the move with the fewest
+  // bits not yet given positions
+  moves,
+  // Elimination orderings, where the first variable eliminated is at
+  // position 0. Min degree removes the variable with the fewest
+  // neighbors, min fill the one which adds the fewest edges.
+  min_degree,
+  min_fill,
+  // Reverse Cuthill-McKee, which keeps neighbors close together
+  rcm
+};
+
+// Every ordering, in the order they are listed to users
+const vector<Ordering>& all_orderings();
+// Command line name of each ordering, such as "min-fill"
+const char* ordering_name(Ordering ordering);
+// Sets "ordering" from its name, returning false if no ordering matches
+bool parse_ordering(const string& name, Ordering& ordering);
+
+// The "moves" ordering, given the bits each move depends on. Uses a
+// bucket queue, so it takes linear time in the size of "dependencies".
+vector<int> order_by_moves(size_t length,
+                           const FlatLists<size_t>& dependencies);
+// Greedy elimination ordering of the variable interaction graph, using
+// either the min fill or min degree rule
+vector<int> order_by_elimination(const vector<unordered_set<size_t>>& graph,
+                                 bool min_fill);
+// Reverse Cuthill-McKee ordering of the variable interaction graph
+vector<int> order_by_rcm(const vector<unordered_set<size_t>>& graph);
+
+#endif /* ORDERING_H_ */
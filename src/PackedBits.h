@@ -0,0 +1,97 @@
+// Brian Goldman
+
+// Helpers for solutions packed 64 bits to a word, where position "i"
+// is bit i % 64 of word i / 64. Bits past the last position are
+// always 0, so whole words can be compared.
+
+#ifndef PACKEDBITS_H_
+#define PACKEDBITS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using std::vector;
+
+// Number of words needed to hold "length" bits
+inline size_t packed_words(size_t length) {
+  return (length + 63) >> 6;
+}
+
+inline bool packed_bit(const vector<uint64_t>& words, size_t position) {
+  return (words[position >> 6] >> (position & 63)) & 1;
+}
+
+inline void toggle_packed_bit(vector<uint64_t>& words, size_t position) {
+  words[position >> 6] ^= uint64_t(1) << (position & 63);
+}
+
+// Position of the lowest set bit in a non-zero word
+inline int lowest_one(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int position = 0;
+  while (not (word & 1)) {
+    word >>= 1;
+    position++;
+  }
+  return position;
+#endif
+}
+
+// Position of the highest set bit in a non-zero word
+inline int highest_one(uint64_t word) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(word);
+#else
+  int position = 0;
+  while (word >>= 1) {
+    position++;
+  }
+  return position;
+#endif
+}
+
+// Finds the lowest set position below "end", returning "end" if
+// there isn't one
+inline size_t first_one(const vector<uint64_t>& words, size_t end) {
+  for (size_t w = 0; (w << 6) < end; w++) {
+    if (words[w]) {
+      size_t position = (w << 6) + lowest_one(words[w]);
+      return position < end ? position : end;
+    }
+  }
+  return end;
+}
+
+// Reverses the order of the bits in a word
+inline uint64_t reverse_bits(uint64_t word) {
+  word = ((word >> 1) & 0x5555555555555555ULL)
+      | ((word & 0x5555555555555555ULL) << 1);
+  word = ((word >> 2) & 0x3333333333333333ULL)
+      | ((word & 0x3333333333333333ULL) << 2);
+  word = ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL)
+      | ((word & 0x0F0F0F0F0F0F0F0FULL) << 4);
+#if defined(__GNUC__)
+  return __builtin_bswap64(word);
+#else
+  word = ((word >> 8) & 0x00FF00FF00FF00FFULL)
+      | ((word & 0x00FF00FF00FF00FFULL) << 8);
+  word = ((word >> 16) & 0x0000FFFF0000FFFFULL)
+      | ((word & 0x0000FFFF0000FFFFULL) << 16);
+  return (word >> 32) | (word << 32);
+#endif
+}
+
+// The 64 bits starting at position "low", with bit 0 holding "low"
+inline uint64_t packed_window(const vector<uint64_t>& words, size_t low) {
+  const size_t w = low >> 6;
+  const size_t shift = low & 63;
+  uint64_t window = words[w] >> shift;
+  if (shift and w + 1 < words.size()) {
+    window |= words[w + 1] << (64 - shift);
+  }
+  return window;
+}
+
+#endif /* PACKEDBITS_H_ */
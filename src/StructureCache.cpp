@@ -0,0 +1,314 @@
+// Brian Goldman
+
+// Implements saving and loading the structure files described in
+// StructureCache.h
+
+#include "StructureCache.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+// Every file starts with this, followed by the subfunctions' row starts
+// and variables, then the file's own arrays. Each array is padded to a
+// multiple of 8 bytes so the next one is aligned.
+struct StructureHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint64_t length;
+  uint64_t radius;
+  uint64_t subfunctions;
+  uint64_t variables;
+  // Number of moves, entries in all of the moves, and links between
+  // moves and subfunctions. Only "moves" is used by order files.
+  uint64_t moves;
+  uint64_t entries;
+  uint64_t links;
+  // Which ordering an order file holds
+  uint64_t ordering;
+};
+const char structure_magic[4] = { 'M', 'K', 'L', 'S' };
+const uint32_t structure_version = 1;
+
+inline size_t padded(size_t bytes) {
+  return (bytes + 7) & ~size_t(7);
+}
+
+// FNV-1a, which is plenty for naming files as matches are checked exactly
+void mix(uint64_t& hash, uint64_t value) {
+  for (int byte = 0; byte < 8; byte++) {
+    hash ^= (value >> (8 * byte)) & 0xFF;
+    hash *= 1099511628211ULL;
+  }
+}
+
+void write_array(std::ostream& out, const void* values, size_t bytes) {
+  static const char zeros[8] = { 0 };
+  out.write(static_cast<const char*>(values), bytes);
+  out.write(zeros, padded(bytes) - bytes);
+}
+
+// Reads arrays in order from a mapped file, checking they are all there
+class ArrayReader {
+ public:
+  ArrayReader(const MappedFile& file_)
+      : file(file_),
+        used(sizeof(StructureHeader)) {
+  }
+  template<class T>
+  const T* next(size_t count) {
+    // Checked before multiplying so huge counts can't overflow
+    if (count > (file.size() - used) / sizeof(T)) {
+      return nullptr;
+    }
+    const size_t bytes = padded(count * sizeof(T));
+    if (used + bytes > file.size()) {
+      return nullptr;
+    }
+    const T* values = reinterpret_cast<const T*>(file.data() + used);
+    used += bytes;
+    return values;
+  }
+  bool finished() const {
+    return used == file.size();
+  }
+ private:
+  const MappedFile& file;
+  size_t used;
+};
+
+// True if "starts" begins at 0, never decreases and ends at "total"
+bool valid_starts(const uint32_t* starts, size_t rows, size_t total) {
+  if (starts[0] != 0 or starts[rows] != total) {
+    return false;
+  }
+  for (size_t row = 0; row < rows; row++) {
+    if (starts[row] > starts[row + 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes "header" followed by the landscape's structure
+void write_structure(std::ostream& out, const StructureHeader& header,
+                     const MKLandscape& landscape) {
+  const auto& variables = landscape.get_variables();
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  write_array(out, variables.row_starts(),
+              (variables.size() + 1) * sizeof(uint32_t));
+  write_array(out, variables.data(), variables.total() * sizeof(size_t));
+}
+
+// Checks the file's header and that it was made from the landscape's
+// exact structure, leaving "reader" at the file's own arrays
+bool read_structure(const MappedFile& file, const StructureHeader& expected,
+                    StructureHeader& header, ArrayReader& reader,
+                    const MKLandscape& landscape) {
+  if (not file.valid() or file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  const auto& variables = landscape.get_variables();
+  if (std::memcmp(header.magic, structure_magic, sizeof(structure_magic))
+      or header.version != structure_version or header.key != expected.key
+      or header.length != expected.length or header.radius != expected.radius
+      or header.subfunctions != variables.size()
+      or header.variables != variables.total()
+      or header.ordering != expected.ordering) {
+    return false;
+  }
+  const uint32_t* starts = reader.next<uint32_t>(variables.size() + 1);
+  const size_t* used = reader.next<size_t>(variables.total());
+  return starts and used
+      and std::memcmp(starts, variables.row_starts(),
+                      (variables.size() + 1) * sizeof(uint32_t)) == 0
+      and std::memcmp(used, variables.data(),
+                      variables.total() * sizeof(size_t)) == 0;
+}
+
+// Files are written under a temporary name so other processes never see
+// a partial file
+bool finish_file(std::ofstream& out, const string& partial,
+                 const string& filename) {
+  if (not out) {
+    std::cerr << "Unable to write structure cache " << filename << std::endl;
+    out.close();
+    std::remove(partial.c_str());
+    return false;
+  }
+  out.close();
+  std::rename(partial.c_str(), filename.c_str());
+  return true;
+}
+}
+
+StructureCache::StructureCache(const string& folder_,
+                               const MKLandscape& landscape_, size_t radius_)
+    : folder(folder_),
+      landscape(landscape_),
+      radius(radius_),
+      key(14695981039346656037ULL) {
+  const auto& variables = landscape.get_variables();
+  mix(key, structure_version);
+  mix(key, landscape.get_length());
+  mix(key, radius);
+  mix(key, variables.size());
+  for (size_t sub = 0; sub < variables.size(); sub++) {
+    mix(key, variables[sub].size());
+    for (const auto& variable : variables[sub]) {
+      mix(key, variable);
+    }
+  }
+}
+
+string StructureCache::filename(const string& suffix) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx",
+                static_cast<unsigned long long>(key));
+  return folder + "/" + name + suffix;
+}
+
+bool StructureCache::load_moves(FlatLists<size_t>& moves,
+                                FlatLists<IndexMask>& move_to_sub) const {
+  if (not enabled()) {
+    return false;
+  }
+  MappedFile file(filename(".moves"));
+  StructureHeader expected = StructureHeader(), header;
+  expected.key = key;
+  expected.length = landscape.get_length();
+  expected.radius = radius;
+  ArrayReader reader(file);
+  // Each move takes more than a byte, which also keeps "moves + 1" from
+  // overflowing
+  if (not read_structure(file, expected, header, reader, landscape)
+      or header.moves >= file.size()) {
+    return false;
+  }
+  auto move_starts = reader.next<uint32_t>(header.moves + 1);
+  auto entries = reader.next<size_t>(header.entries);
+  auto link_starts = reader.next<uint32_t>(header.moves + 1);
+  auto links = reader.next<IndexMask>(header.links);
+  if (not move_starts or not entries or not link_starts or not links
+      or not reader.finished()
+      or not valid_starts(move_starts, header.moves, header.entries)
+      or not valid_starts(link_starts, header.moves, header.links)) {
+    return false;
+  }
+  // Walks trust every index, so a damaged file must not get that far
+  for (size_t i = 0; i < header.entries; i++) {
+    if (entries[i] >= header.length) {
+      return false;
+    }
+  }
+  const auto& variables = landscape.get_variables();
+  for (size_t i = 0; i < header.links; i++) {
+    if (links[i].index >= header.subfunctions
+        or links[i].mask >> variables[links[i].index].size()) {
+      return false;
+    }
+  }
+  moves.assign(header.moves, move_starts, entries);
+  move_to_sub.assign(header.moves, link_starts, links);
+  return true;
+}
+
+void StructureCache::save_moves(const FlatLists<size_t>& moves,
+                                const FlatLists<IndexMask>& move_to_sub) const {
+  if (not enabled()) {
+    return;
+  }
+  StructureHeader header = StructureHeader();
+  std::memcpy(header.magic, structure_magic, sizeof(structure_magic));
+  header.version = structure_version;
+  header.key = key;
+  header.length = landscape.get_length();
+  header.radius = radius;
+  header.subfunctions = landscape.get_variables().size();
+  header.variables = landscape.get_variables().total();
+  header.moves = moves.size();
+  header.entries = moves.total();
+  header.links = move_to_sub.total();
+  const string name = filename(".moves");
+  const string partial = name + ".partial";
+  std::ofstream out(partial, std::ios::binary);
+  write_structure(out, header, landscape);
+  write_array(out, moves.row_starts(), (moves.size() + 1) * sizeof(uint32_t));
+  write_array(out, moves.data(), moves.total() * sizeof(size_t));
+  write_array(out, move_to_sub.row_starts(),
+              (move_to_sub.size() + 1) * sizeof(uint32_t));
+  write_array(out, move_to_sub.data(),
+              move_to_sub.total() * sizeof(IndexMask));
+  finish_file(out, partial, name);
+}
+
+bool StructureCache::load_order(Ordering ordering, size_t move_count,
+                                vector<int>& new_to_org,
+                                vector<size_t>& move_to_bin) const {
+  if (not enabled()) {
+    return false;
+  }
+  MappedFile file(filename(string(".") + ordering_name(ordering) + ".order"));
+  StructureHeader expected = StructureHeader(), header;
+  expected.key = key;
+  expected.length = landscape.get_length();
+  expected.radius = radius;
+  expected.ordering = uint64_t(ordering);
+  ArrayReader reader(file);
+  if (not read_structure(file, expected, header, reader, landscape)
+      or header.moves != move_count) {
+    return false;
+  }
+  auto positions = reader.next<int32_t>(header.length);
+  auto bins = reader.next<size_t>(header.moves);
+  if (not positions or not bins or not reader.finished()) {
+    return false;
+  }
+  // Positions must be a permutation, and every bin a position
+  vector<char> used(header.length, false);
+  for (size_t i = 0; i < header.length; i++) {
+    if (positions[i] < 0 or uint64_t(positions[i]) >= header.length
+        or used[positions[i]]) {
+      return false;
+    }
+    used[positions[i]] = true;
+  }
+  for (size_t i = 0; i < header.moves; i++) {
+    if (bins[i] >= header.length) {
+      return false;
+    }
+  }
+  new_to_org.assign(positions, positions + header.length);
+  move_to_bin.assign(bins, bins + header.moves);
+  return true;
+}
+
+void StructureCache::save_order(Ordering ordering,
+                                const vector<int>& new_to_org,
+                                const vector<size_t>& move_to_bin) const {
+  if (not enabled()) {
+    return;
+  }
+  StructureHeader header = StructureHeader();
+  std::memcpy(header.magic, structure_magic, sizeof(structure_magic));
+  header.version = structure_version;
+  header.key = key;
+  header.length = landscape.get_length();
+  header.radius = radius;
+  header.subfunctions = landscape.get_variables().size();
+  header.variables = landscape.get_variables().total();
+  header.moves = move_to_bin.size();
+  header.ordering = uint64_t(ordering);
+  const string name = filename(string(".") + ordering_name(ordering)
+                               + ".order");
+  const string partial = name + ".partial";
+  std::ofstream out(partial, std::ios::binary);
+  write_structure(out, header, landscape);
+  write_array(out, new_to_org.data(), new_to_org.size() * sizeof(int32_t));
+  write_array(out, move_to_bin.data(), move_to_bin.size() * sizeof(size_t));
+  finish_file(out, partial, name);
+}
@@ -0,0 +1,49 @@
+// Brian Goldman
+
+// Saves the parts of an Enumeration's setup which only depend on which
+// variables each subfunction uses, not on the fitness tables. Later runs
+// on a landscape with the same structure and radius, such as the same
+// file with different flags or a sweep which only changes the tables,
+// load them instead of finding them again. Files are kept in a folder
+// and named by a hash of the structure and radius:
+// * HASH.moves holds every move and the subfunctions each one changes
+// * HASH.ORDERING.order holds an ordering's positions and move bins
+// Each file also stores the structure it was made from, so a file is
+// only used when the structure matches exactly. Like landscape caches,
+// they store arrays exactly as they are held in memory, so they are only
+// meant to be read on the machine that wrote them.
+
+#ifndef STRUCTURECACHE_H_
+#define STRUCTURECACHE_H_
+
+#include "MKLandscape.h"
+#include "DeltaKernels.h"
+#include "Ordering.h"
+
+class StructureCache {
+ public:
+  // Does nothing if "folder_" is empty
+  StructureCache(const string& folder_, const MKLandscape& landscape_,
+                 size_t radius_);
+  inline bool enabled() const {
+    return folder.size();
+  }
+  // Each load returns false if nothing usable was cached
+  bool load_moves(FlatLists<size_t>& moves,
+                  FlatLists<IndexMask>& move_to_sub) const;
+  void save_moves(const FlatLists<size_t>& moves,
+                  const FlatLists<IndexMask>& move_to_sub) const;
+  bool load_order(Ordering ordering, size_t move_count,
+                  vector<int>& new_to_org, vector<size_t>& move_to_bin) const;
+  void save_order(Ordering ordering, const vector<int>& new_to_org,
+                  const vector<size_t>& move_to_bin) const;
+ private:
+  string folder;
+  const MKLandscape& landscape;
+  size_t radius;
+  // Hash of the structure and radius, used to name the files
+  uint64_t key;
+  string filename(const string& suffix) const;
+};
+
+#endif /* STRUCTURECACHE_H_ */
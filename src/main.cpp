@@ -19,25 +19,281 @@
 // and will output all 1 bit local optima to "output.txt"
 // There are also optional switches which can disable hyperplane elimination and
 // disable reordering, both of which are enabled by default.
+// Adding "--threads 8" anywhere after the program name will split the
+// enumeration between 8 threads, and "--binary" writes the local optima
+// using the compact binary format described in OptimaFile.h.
+// "--count-only" only writes how many local optima there are, and
+// "--histogram 10" writes how many local optima have each fitness along
+// with the 10 best local optima.
+// Long serial runs can save their progress using "--checkpoint run.ckpt",
+// which by default is updated every 10 minutes (change with
+// "--checkpoint-every SECONDS"). If the run is stopped, calling it again
+// with the same arguments plus "--resume" continues where it left off.
+// "--ordering min-fill" changes which heuristic reorders the variables
+// (see Ordering.h), and "--compare-orderings" only prints the predicted
+// cost of every ordering. "--cache-landscape" saves a binary copy of the
+// parsed landscape next to the input (input_filename.cache), which later
+// runs load instead of parsing the text as long as the text is unchanged.
+// A progress line is printed every 10 seconds, which can be changed with
+// "--progress-every SECONDS" (0 turns it off), and "--stats" prints counts
+// of what the enumeration did once it finishes.
+// "--min-fitness 40" only finds local optima with at least fitness 40, and
+// "--top-k 10" only keeps the 10 best local optima. Both skip hyperplanes
+// which can't contain a wanted local optimum.
+// "--all-radii" finds every 1-bit local optimum in a single run and adds
+// a column giving the largest radius (up to the given radius) at which
+// each is still a local optimum, so "radius 3 --all-radii" replaces
+// separate runs at radius 1, 2 and 3.
+// "--lazy-moves" only keeps single bit moves up to date as the walk
+// flips bits, checking larger moves only when they are needed. This is
+// usually faster at radius 2 and up.
+// "--auto" decides whether to use hyperplanes and which ordering by
+// predicting the cost of each and timing short walks, and writes the
+// choice in the output header.
+// "--structure-cache folder" saves the moves and orderings found for a
+// landscape in "folder", and loads them on later runs using the same
+// radius and subfunction variables, even if the fitness tables differ.
+// "--components" enumerates each connected component of the variable
+// interaction graph on its own, in parallel, and writes each component's
+// local optima instead of every combination of them. The count is their
+// product. Adding "--expand" writes every combination as normal.
+// "--merge-subfunctions 4" sums subfunctions into one table when one's
+// variables are a subset of the other's, or when together they use at
+// most 4 variables which already all interact, which reduces the work of
+// each flip without changing the local optima.
+// Binary files can be converted back to text using:
+// Release/MKL --decode output.bin output.txt
+// Large enumerations can be split across machines with "--shard 3/8",
+// which makes this run enumerate the fourth of 8 parts. Every shard
+// must be given the same landscape, radius and settings. The outputs
+// are then combined using:
+// Release/MKL --merge output.txt shard0.txt shard1.txt ...
+// Many enumerations can be run in one process using:
+// Release/MKL --batch jobs.txt results.csv --threads 8 --time-limit 3600
+// where each line of jobs.txt is "input_filename radius [use_hyperplanes]
+// [use_reordering]" (see Batch.h).
 
 #include "MKLandscape.h"
 #include "GraphUtilities.h"
 #include "Enumeration.h"
+#include "OptimaFile.h"
+#include "OptimaWriter.h"
+#include "OptimaSummary.h"
+#include "OptimaMerge.h"
+#include "Components.h"
+#include "Batch.h"
 
 #include <iostream>
 using namespace std;
 #include <cassert>
 #include <fstream>
+#include <memory>
+#include <limits>
+#include <unistd.h>
 
 int main(int argc, char * argv[]) {
-  if (argc < 4) {
+  // Separate "--flag value" options from the positional arguments
+  vector<string> positional;
+  // Everything that configures the enumeration itself
+  EnumerationOptions options;
+  OptimaFormat format = OptimaFormat::text;
+  // Summary modes skip writing each local optimum
+  bool count_only = false;
+  int histogram = -1;
+  string checkpoint_file;
+  double checkpoint_seconds = 600;
+  bool resume = false;
+  bool known_ordering = true;
+  bool compare_orderings = false;
+  bool cache_landscape = false;
+  bool components = false;
+  bool expand = false;
+  bool merge = false;
+  int merge_arity = 0;
+  // Parsed as signed so negative values can be rejected
+  int threads = 1;
+  bool keep_top = false;
+  int top_k = 0;
+  string batch_manifest, batch_output;
+  double time_limit = 0;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--threads" and i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (arg == "--binary") {
+      format = OptimaFormat::binary;
+    } else if (arg == "--count-only") {
+      count_only = true;
+    } else if (arg == "--histogram" and i + 1 < argc) {
+      histogram = atoi(argv[++i]);
+    } else if (arg == "--checkpoint" and i + 1 < argc) {
+      checkpoint_file = argv[++i];
+    } else if (arg == "--checkpoint-every" and i + 1 < argc) {
+      checkpoint_seconds = atof(argv[++i]);
+    } else if (arg == "--resume") {
+      resume = true;
+    } else if (arg == "--ordering" and i + 1 < argc) {
+      known_ordering = parse_ordering(argv[++i], options.ordering);
+    } else if (arg == "--cache-landscape") {
+      cache_landscape = true;
+    } else if (arg == "--stats") {
+      options.stats = true;
+    } else if (arg == "--progress-every" and i + 1 < argc) {
+      options.progress_seconds = atof(argv[++i]);
+    } else if (arg == "--min-fitness" and i + 1 < argc) {
+      options.min_fitness = atoi(argv[++i]);
+    } else if (arg == "--top-k" and i + 1 < argc) {
+      keep_top = true;
+      top_k = atoi(argv[++i]);
+    } else if (arg == "--all-radii") {
+      options.all_radii = true;
+    } else if (arg == "--lazy-moves") {
+      options.lazy = true;
+    } else if (arg == "--auto") {
+      options.automatic = true;
+    } else if (arg == "--structure-cache" and i + 1 < argc) {
+      options.structure_cache = argv[++i];
+    } else if (arg == "--components") {
+      components = true;
+    } else if (arg == "--expand") {
+      expand = true;
+    } else if (arg == "--merge-subfunctions" and i + 1 < argc) {
+      merge = true;
+      merge_arity = atoi(argv[++i]);
+    } else if (arg == "--batch" and i + 2 < argc) {
+      batch_manifest = argv[++i];
+      batch_output = argv[++i];
+    } else if (arg == "--time-limit" and i + 1 < argc) {
+      time_limit = atof(argv[++i]);
+    } else if (arg == "--compare-orderings") {
+      compare_orderings = true;
+    } else if (arg == "--shard" and i + 1 < argc) {
+      // Given as "index/total"
+      string part = argv[++i];
+      size_t slash = part.find('/');
+      options.shard = atoi(part.substr(0, slash).c_str());
+      options.shards = slash == string::npos ? 0 : atoi(part.substr(slash + 1).c_str());
+    } else if (arg == "--decode" and i + 2 < argc) {
+      // Convert a binary local optima file into text
+      ifstream in(argv[i + 1], ios::binary);
+      ofstream out(argv[i + 2]);
+      return optima_to_text(in, out) ? 0 : 1;
+    } else if (arg == "--merge" and i + 2 < argc) {
+      // Combine the outputs of every shard
+      vector<string> shard_files(argv + i + 2, argv + argc);
+      ofstream out(argv[i + 1], ios::binary);
+      return merge_optima(shard_files, out) ? 0 : 1;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  bool bad_threads = threads < 1;
+  if (not bad_threads) {
+    options.threads = threads;
+  }
+  bool bad_top_k = keep_top and top_k < 1;
+  if (keep_top and not bad_top_k) {
+    options.top_k = top_k;
+  }
+  if (batch_manifest.size() and not bad_threads) {
+    return run_batch(batch_manifest, batch_output, options.threads,
+                     time_limit) ? 0 : 1;
+  }
+  // Checkpoints only record a single walk, and don't store the top k
+  bool bad_checkpoint = (resume and checkpoint_file.empty())
+      or (checkpoint_file.size()
+          and (options.threads > 1 or options.shards > 1 or options.top_k));
+  // Each shard keeps its own best k, which merging would not trim again
+  bool bad_shard = options.shards < 1 or options.shard >= options.shards
+      or (options.shards > 1 and options.top_k);
+  bool too_few = positional.size() < (compare_orderings ? 2 : 3);
+  // The best optima are kept without their radius
+  bool bad_radii = options.all_radii and options.top_k;
+  // Components are enumerated whole, and factored output is only text
+  bool bad_components = components
+      and (checkpoint_file.size() or options.shards > 1 or options.top_k
+          or options.min_fitness != numeric_limits<int>::min()
+          or (not expand and not count_only
+              and (format != OptimaFormat::text or histogram >= 0)));
+  bool bad_merge = merge and merge_arity < 1;
+  // Timing differs between machines, so shards could choose differently
+  bool bad_auto = options.automatic and (components or options.shards > 1);
+  if (too_few or bad_threads or bad_top_k or bad_checkpoint or bad_shard or bad_radii
+      or bad_components or (expand and not components) or not known_ordering
+      or bad_merge or bad_auto) {
     // Help message
     cout
-        << "Usage: input_filename output_filename radius [use_hyperplanes] [use_reordering]"
+        << "Usage: input_filename output_filename radius [use_hyperplanes] [use_reordering] [--threads N] [--binary | --count-only | --histogram K]"
+        << endl
+        << "       [--checkpoint FILE [--checkpoint-every SECONDS] [--resume]] [--shard I/N]"
+        << endl
+        << "       [--ordering moves | min-degree | min-fill | rcm | none] [--cache-landscape]"
+        << endl
+        << "       [--progress-every SECONDS] [--stats] [--min-fitness F] [--top-k K] [--all-radii] [--lazy-moves]"
+        << endl
+        << "       [--components [--expand]] [--merge-subfunctions K] [--structure-cache FOLDER] [--auto]"
+        << endl
+        << "       input_filename radius [use_hyperplanes] --compare-orderings"
+        << endl
+        << "       --decode binary_filename text_filename"
+        << endl
+        << "       --merge output_filename shard_filename..."
+        << endl
+        << "       --batch manifest_filename csv_filename [--threads N] [--time-limit SECONDS]"
         << endl
         << endl
         << "By default hyperplanes and reordering are used, but can be set to 0 to turn off"
         << endl
+        << "--threads splits the search between N threads, defaults to 1"
+        << endl
+        << "--binary writes local optima in the compact binary format"
+        << endl
+        << "--count-only only writes how many local optima were found"
+        << endl
+        << "--histogram writes how many local optima have each fitness, and the best K"
+        << endl
+        << "--checkpoint periodically saves progress to FILE, every 600 seconds by default"
+        << endl
+        << "--resume continues from the checkpoint FILE. Checkpoints require 1 thread and no --top-k"
+        << endl
+        << "--ordering chooses how variables are reordered, defaults to moves"
+        << endl
+        << "--cache-landscape saves the parsed landscape next to the input, and loads it on later runs"
+        << endl
+        << "--progress-every prints progress every SECONDS, defaults to 10, 0 turns it off"
+        << endl
+        << "--stats prints counts of flips, table lookups, carries and skipped hyperplanes"
+        << endl
+        << "--min-fitness only finds local optima with fitness F or higher"
+        << endl
+        << "--top-k only keeps the K local optima with the highest fitness, and can't be used with --shard"
+        << endl
+        << "--all-radii finds all 1-bit local optima, writing the largest radius each is optimal at"
+        << endl
+        << "--lazy-moves only checks moves of more than one bit when they are needed"
+        << endl
+        << "--auto picks hyperplanes and the ordering expected to finish first, instead of the given settings"
+        << endl
+        << "--structure-cache saves moves and orderings in FOLDER, and loads them for the same structure"
+        << endl
+        << "--components enumerates each connected component separately, writing their local optima"
+        << endl
+        << "--expand writes every combination of the components' local optima instead"
+        << endl
+        << "--merge-subfunctions sums nested subfunctions, and overlapping ones using at most K variables"
+        << endl
+        << "--compare-orderings prints the predicted cost of each ordering without enumerating"
+        << endl
+        << "--shard only enumerates part I (counting from 0) of N parts of the search space"
+        << endl
+        << "--decode converts a binary local optima file into text"
+        << endl
+        << "--merge combines the outputs of all N shards"
+        << endl
+        << "--batch runs every job in the manifest, writing one CSV row per finished job"
+        << endl
+        << "--time-limit stops each batch job after SECONDS, defaults to no limit"
+        << endl
         << "Example: ./MKL input.txt output.txt 2 1 0"
         << endl
         << "         This will read a problem from input.txt, write local optima to output.txt,"
@@ -46,26 +302,126 @@ int main(int argc, char * argv[]) {
         << endl;
     return 0;
   }
-  string problem_file = argv[1];
-  string output_file = argv[2];
-  int radius = atoi(argv[3]);
+  if (compare_orderings) {
+    // There is no output file
+    positional.insert(positional.begin() + 1, "");
+  }
+  string problem_file = positional[0];
+  string output_file = positional[1];
+  options.radius = atoi(positional[2].c_str());
 
-  bool hyper = true;
-  if (argc > 4) {
+  if (positional.size() > 3) {
     // Turn off hyperplane elimination if 3rd argument is 0
-    hyper = atoi(argv[4]) != 0;
+    options.hyper = atoi(positional[3].c_str()) != 0;
   }
-  bool reorder = true;
-  if (argc > 5) {
+  if (positional.size() > 4 and atoi(positional[4].c_str()) == 0) {
     // Turn off reordering if 4th argument is 0
-    reorder = atoi(argv[5]) != 0;
+    options.ordering = Ordering::none;
   }
   // Construct the landscape
-  MKLandscape problem(problem_file);
+  MKLandscape problem(problem_file, cache_landscape);
+  if (not problem.valid()) {
+    return 1;
+  }
+  // Kept to report how much work merging saves
+  FlatLists<size_t> unmerged;
+  if (merge) {
+    unmerged = problem.get_variables();
+    size_t removed = problem.merge_subfunctions(merge_arity);
+    cout << "Merged " << unmerged.size() << " subfunctions into "
+         << unmerged.size() - removed << endl;
+  }
+  if (compare_orderings) {
+    Enumeration find_local(problem, options);
+    for (const auto& option : all_orderings()) {
+      cout << ordering_name(option) << " predicted cost: "
+           << find_local.predict_cost(option, options.hyper) << endl;
+    }
+    return 0;
+  }
+  Checkpoint checkpoint;
+  fstream out;
+  if (resume) {
+    if (not read_checkpoint(checkpoint_file, checkpoint)) {
+      return 1;
+    }
+    // Throw away anything written after the checkpoint
+    if (truncate(output_file.c_str(), checkpoint.output_offset) != 0) {
+      cout << "Unable to truncate " << output_file << endl;
+      return 1;
+    }
+    out.open(output_file, ios::binary | ios::in | ios::out);
+  } else {
+    out.open(output_file, ios::binary | ios::out | ios::trunc);
+  }
+  // Choose what happens to each local optimum
+  unique_ptr<OptimaSink> sink;
+  if (count_only) {
+    sink.reset(new CountSink(out));
+  } else if (histogram >= 0) {
+    sink.reset(new HistogramSink(out, histogram));
+  } else {
+    sink.reset(new OptimaWriter(out, format));
+  }
+  // Keeps only the best optima, then hands them to the chosen sink
+  unique_ptr<OptimaSink> top;
+  if (options.top_k) {
+    top.reset(new TopSink(*sink, options.top_k));
+  }
+  OptimaSink& receiver = top ? *top : *sink;
+  if (components) {
+    ComponentEnumeration parts(problem, options.radius);
+    parts.set_all_radii(options.all_radii);
+    cout << "Enumerating " << parts.size() << " components using "
+         << options.threads << " threads" << endl;
+    parts.enumerate(options.hyper, options.ordering, options.threads,
+                    not count_only);
+    bool overflow;
+    uint64_t count = parts.count(overflow);
+    if (overflow) {
+      cout << "Too many local optima to count, found at least " << count
+           << endl;
+    }
+    if (count_only) {
+      sink->start(parts.header());
+      sink->finish(count, parts.header().seconds);
+    } else if (expand) {
+      parts.expand(*sink);
+    } else {
+      parts.write_factored(out);
+    }
+    return 0;
+  }
   // Construct the enumeration tool
-  Enumeration find_local(problem, radius);
-  ofstream out(output_file);
-  // Find all local optima
-  find_local.enumerate(out, hyper, reorder);
+  Enumeration find_local(problem, options);
+  if (merge) {
+    cout << "Table lookups to flip every variable reduced from "
+         << find_local.flip_lookups(unmerged) << " to "
+         << find_local.flip_lookups(problem.get_variables()) << endl;
+  }
+  if (checkpoint_file.size()) {
+    find_local.set_checkpoint(checkpoint_file, checkpoint_seconds);
+  }
+  if (resume) {
+    // Continue finding local optima from where the checkpoint stopped
+    if (not find_local.resume(receiver, checkpoint)) {
+      return 1;
+    }
+  } else if (options.automatic) {
+    find_local.enumerate_automatic(receiver, options.threads);
+  } else {
+    // Find all local optima
+    find_local.enumerate(receiver, options.hyper, options.ordering,
+                         options.threads);
+  }
+  // Lets scripts like bench.py see where the time went
+  const auto& times = find_local.phase_times();
+  cout << "Phase seconds: graph " << times.graph << " moves " << times.moves
+       << " tables " << times.tables << " remap " << times.remap
+       << " estimate " << times.estimate << " enumerate " << times.enumerate
+       << endl;
+  if (options.stats) {
+    find_local.walk_stats().write(cout);
+  }
   return 0;
 }